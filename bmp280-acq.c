@@ -0,0 +1,932 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/sched.h>
+
+#include "bmp280.h"
+
+/*
+ * The latest sample of a sensor and the optional background acquisition keeping it
+ * fresh. While acquisition runs, readers are served from the published sample and cost
+ * no bus traffic at all. Without it, the sample is still reused for as long as the
+ * sensor cannot have produced a new conversion.
+ */
+
+static const char * const bmp280_acq_modes[] = {
+    [BMP280_ACQ_OFF] = "off",
+    [BMP280_ACQ_PERIODIC] = "periodic",
+    [BMP280_ACQ_HIGHRATE] = "highrate",
+    [BMP280_ACQ_ADAPTIVE] = "adaptive",
+};
+
+#define BMP280_ADAPT_WINDOW_MS 250 // Shortest time dP/dt is taken over, keeps sensor noise out of it
+#define BMP280_ADAPT_CALM      4   // Calm windows in a row before the rate steps down
+
+/*
+ * Makes a compensated sample the latest one of the sensor and queues it for the
+ * character device. The seqlock's own spinlock serializes the writers (the workers and
+ * readers that went to the sensor), which also makes them the fifo's single producer.
+ * Readers of the character device and pollers of Bmp280-Calculations are only woken
+ * for samples that made it past the deadband.
+ */
+void bmp280_publish(struct bmp280_data *data, const struct bmp280_sample *sample)
+{
+    write_seqlock(&data->latest.lock);
+    data->latest.sample = *sample;
+    bool delivered = bmp280_cdev_push(data, sample);
+    write_sequnlock(&data->latest.lock);
+
+    if(delivered) {
+        wake_up_interruptible(&data->cdev->fifo_wait);
+        sysfs_notify(&data->dev->kobj, NULL, "Bmp280-Calculations");
+    }
+}
+
+/*
+ * Copies the latest sample out, returns false if nothing has been published yet. Lock
+ * free, a reader that raced with a writer simply copies again.
+ */
+bool bmp280_latest(struct bmp280_data *data, struct bmp280_sample *sample)
+{
+    unsigned int seq;
+
+    do {
+        seq = read_seqbegin(&data->latest.lock);
+        *sample = data->latest.sample;
+    } while(read_seqretry(&data->latest.lock, seq));
+
+    return sample->timestamp != 0;
+}
+
+/*
+ * Reuse window of the latest sample in microseconds. In forced mode the sensor only
+ * converts when asked to, so "auto" means every read gets a fresh conversion.
+ */
+static unsigned int bmp280_cache_ttl_us(struct bmp280_data *data)
+{
+    unsigned int ttl_us = READ_ONCE(data->cache_ttl_us);
+
+    if(ttl_us != BMP280_TTL_AUTO)
+        return ttl_us;
+    return READ_ONCE(data->on_demand) ? 0 : bmp280_period_us(data);
+}
+
+/*
+ * Purpose:
+ *   Copies the latest sample out if a reader may use it instead of reading the sensor.
+ *
+ * Parameters:
+ *   @data:   Pointer to the BMP280 driver data.
+ *   @sample: Output, the latest sample.
+ *
+ * Return:
+ *   True if the sample may be used, false if the sensor has to be read.
+ *
+ * Details:
+ *   The background worker keeps the sample fresh while acquisition runs. Otherwise it
+ *   is reused while younger than the cache TTL, which by default is one normal-mode
+ *   period (t_measure + t_sb): the data registers cannot have changed any sooner, so
+ *   going to the bus would only return the same conversion again.
+ */
+bool bmp280_fresh(struct bmp280_data *data, struct bmp280_sample *sample)
+{
+    if(!bmp280_latest(data, sample))
+        return false;
+    if(READ_ONCE(data->acq_mode) != BMP280_ACQ_OFF)
+        return true;
+
+    return ktime_us_delta(ktime_get(), sample->timestamp) < bmp280_cache_ttl_us(data);
+}
+
+/* Accounts one duration in min/avg/max and its log2 microsecond histogram bucket */
+static void bmp280_acq_latency_add(struct bmp280_data *data, struct bmp280_latency *lat, s64 ns)
+{
+    u64 us = max_t(s64, ns, 0) / NSEC_PER_USEC;
+    unsigned int bucket = us ? min_t(unsigned int, ilog2(us) + 1, BMP280_HIST_BUCKETS - 1) : 0;
+
+    spin_lock(&data->read_lock);
+    lat->min_ns = lat->count ? min(lat->min_ns, ns) : ns;
+    lat->max_ns = lat->count ? max(lat->max_ns, ns) : ns;
+    lat->sum_ns += ns;
+    lat->count++;
+    lat->hist[bucket]++;
+    spin_unlock(&data->read_lock);
+}
+
+/*
+ * Purpose:
+ *   Periodic acquisition step, fetches one normal-mode conversion per run.
+ *
+ * Parameters:
+ *   @data:      Pointer to the BMP280 driver data.
+ *   @published: Output, the sample if a new one was published, NULL if not needed.
+ *
+ * Return:
+ *   Time of the next run.
+ *
+ * Details:
+ *   In normal mode the sensor produces a new result every t_measure + t_sb, timed by
+ *   its own standby oscillator which drifts against host time, so a fixed host period
+ *   sooner or later reads a conversion twice or skips one. The step phase-locks to
+ *   the sensor instead:
+ *     - A read whose raw data equals the previous one is a duplicate, the conversion
+ *       has not landed yet. Nothing is published and the read is retried a guard time
+ *       (1/32 period) later, moving the aim point later by the same amount.
+ *     - A new conversion updates the period estimate (EWMA over 8 samples) from the
+ *       time since the last one, divided by the number of periods it spans, any
+ *       periods beyond the first being counted as missed.
+ *     - After each new conversion the next read is aimed at the estimated period, minus
+ *       a lead that creeps up by 1/512 period per sample, so reads slide towards the
+ *       moment the conversion lands until a duplicate pushes them back.
+ *   This settles with reads within a few percent of a period after each conversion,
+ *   at the cost of roughly one duplicate read per 16 samples. The estimate restarts
+ *   whenever the oversampling or standby time change. Two consecutive conversions with
+ *   identical raw data would be taken for a duplicate, with 20-bit readings and sensor
+ *   noise that does not happen in practice.
+ */
+static ktime_t bmp280_acq_periodic(struct bmp280_data *data, struct bmp280_sample *published)
+{
+    struct bmp280_phase *ph = &data->phase;
+    struct bmp280_sample sample;
+
+    s64 nominal_ns = (s64)bmp280_period_us(data) * NSEC_PER_USEC;
+    if(!nominal_ns)
+        return ktime_add_ns(ktime_get(), NSEC_PER_SEC); // Settings unreadable, retry slowly
+
+    if(nominal_ns != ph->nominal_ns) {
+        memset(ph, 0, offsetof(struct bmp280_phase, duplicates));
+        ph->nominal_ns = nominal_ns;
+        ph->period_ns = nominal_ns;
+        WRITE_ONCE(ph->estimate_ns, nominal_ns);
+    }
+
+    s64 guard_ns = ph->period_ns / 32;
+
+    ktime_t start = ktime_get();
+    int ret = bmp280_read_raw(data, true, sample.raw);
+    ktime_t now = ktime_get();
+    if(ret < 0) {
+        dev_err_ratelimited(data->dev, "Failed to read a sample in the background\n");
+        return ktime_add_ns(now, ph->period_ns);
+    }
+    bmp280_acq_latency_add(data, &data->read_time, ktime_to_ns(ktime_sub(now, start)));
+
+    if(ph->last_new && !memcmp(sample.raw, ph->last_raw, BMP280_DATA_LEN)) {
+        WRITE_ONCE(ph->duplicates, ph->duplicates + 1);
+        ph->lead_ns = max(ph->lead_ns - guard_ns, -ph->period_ns / 2);
+        return ktime_add_ns(now, guard_ns);
+    }
+
+    if(ph->last_new) {
+        s64 interval = ktime_to_ns(ktime_sub(now, ph->last_new));
+        s64 periods = max_t(s64, div64_s64(interval + ph->period_ns / 2, ph->period_ns), 1);
+
+        WRITE_ONCE(ph->missed, ph->missed + periods - 1);
+        ph->period_ns += div64_s64(div64_s64(interval, periods) - ph->period_ns, 8);
+        WRITE_ONCE(ph->estimate_ns, ph->period_ns);
+    }
+    ph->last_new = now;
+    memcpy(ph->last_raw, sample.raw, BMP280_DATA_LEN);
+
+    sample.timestamp = now;
+    if(bmp280_compensate_sample(data, &sample) == 0) {
+        bmp280_publish(data, &sample);
+        if(published)
+            *published = sample;
+    }
+
+    ph->lead_ns = min(ph->lead_ns + ph->period_ns / 512, ph->period_ns / 2);
+    return ktime_add_ns(now, ph->period_ns - ph->lead_ns);
+}
+
+/* t_measure + t_sb of a standby code with the active oversampling, 0 if unreadable */
+static unsigned int bmp280_acq_adapt_period_us(struct bmp280_data *data, unsigned int t_sb)
+{
+    unsigned int ctrl_meas;
+
+    if(regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas) < 0)
+        return 0;
+    return bmp280_measure_time_us(data, ctrl_meas) + bmp280_standby_time_us(t_sb);
+}
+
+/* Slowest standby code within max_period_us, the fastest one if none is */
+static unsigned int bmp280_acq_adapt_slowest(struct bmp280_data *data)
+{
+    unsigned int max_us = READ_ONCE(data->adapt.max_period_us);
+
+    for(unsigned int t_sb = BMP280_T_SB_MASK >> BMP280_T_SB_SHIFT; t_sb > 0; t_sb--) {
+        if(bmp280_acq_adapt_period_us(data, t_sb) <= max_us)
+            return t_sb;
+    }
+    return 0;
+}
+
+/* Fastest standby code within min_period_us, never slower than the slowest one */
+static unsigned int bmp280_acq_adapt_fastest(struct bmp280_data *data)
+{
+    unsigned int min_us = READ_ONCE(data->adapt.min_period_us);
+    unsigned int slowest = bmp280_acq_adapt_slowest(data);
+    unsigned int t_sb = 0;
+
+    while(t_sb < slowest && bmp280_acq_adapt_period_us(data, t_sb) < min_us)
+        t_sb++;
+    return t_sb;
+}
+
+/*
+ * Purpose:
+ *   Adaptive acquisition step, fetches a conversion like periodic acquisition and
+ *   adjusts t_sb to how fast pressure changes.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *
+ * Return:
+ *   Time of the next run.
+ *
+ * Details:
+ *   |dP/dt| is taken between published samples at least 250 ms apart, short enough to
+ *   catch a door opening and long enough that sensor noise does not look like a change.
+ *   Above rise_pa_s the standby time drops straight to the fastest code allowed by
+ *   min_period_us, so an event is sampled densely from its start. Below fall_pa_s for
+ *   four windows in a row it steps one code slower, up to the slowest one allowed by
+ *   max_period_us. In between the rate holds. The fastest code, t_sb = 0.5 ms, is close
+ *   to back-to-back conversions while the sensor keeps pacing itself. A t_sb change
+ *   restarts the sensor's cycle, the phase lock of bmp280_acq_periodic() follows by
+ *   itself since the nominal period changes with it.
+ */
+static ktime_t bmp280_acq_adaptive(struct bmp280_data *data)
+{
+    struct bmp280_adapt *ad = &data->adapt;
+    struct bmp280_sample sample;
+
+    sample.timestamp = 0;
+    ktime_t next = bmp280_acq_periodic(data, &sample);
+    if(!sample.timestamp || !sample.press)
+        return next;
+
+    if(!ad->ref_time) {
+        ad->ref_time = sample.timestamp;
+        ad->ref_press = sample.press;
+        return next;
+    }
+
+    s64 window_us = ktime_us_delta(sample.timestamp, ad->ref_time);
+    if(window_us < BMP280_ADAPT_WINDOW_MS * USEC_PER_MSEC)
+        return next;
+
+    u64 delta = abs((s64)sample.press - ad->ref_press);
+    u64 slope = div64_u64(delta * USEC_PER_SEC, window_us);
+    WRITE_ONCE(ad->slope, slope);
+    ad->ref_time = sample.timestamp;
+    ad->ref_press = sample.press;
+
+    unsigned int t_sb = ad->t_sb;
+    if(slope > (u64)READ_ONCE(ad->rise_pa_s) << 8) {
+        ad->calm = 0;
+        t_sb = bmp280_acq_adapt_fastest(data);
+    } else if(slope < (u64)READ_ONCE(ad->fall_pa_s) << 8) {
+        if(++ad->calm >= BMP280_ADAPT_CALM) {
+            ad->calm = 0;
+            t_sb = min(t_sb + 1, bmp280_acq_adapt_slowest(data));
+        }
+    } else {
+        ad->calm = 0;
+    }
+
+    if(t_sb == ad->t_sb)
+        return next;
+
+    if(bmp280_update_field(data, BMP280_REG_CONFIG, BMP280_T_SB_MASK, t_sb << BMP280_T_SB_SHIFT) < 0) {
+        dev_err_ratelimited(data->dev, "Failed to change the standby time\n");
+        return next;
+    }
+
+    if(t_sb < ad->t_sb)
+        WRITE_ONCE(ad->steps_up, ad->steps_up + 1);
+    else
+        WRITE_ONCE(ad->steps_down, ad->steps_down + 1);
+    WRITE_ONCE(ad->t_sb, t_sb);
+
+    // The sensor starts a new cycle right away, read it as soon as it can be done
+    return ktime_add_us(ktime_get(), bmp280_acq_adapt_period_us(data, t_sb));
+}
+
+/*
+ * Resets the controller and drops to the slowest allowed rate, remembering the standby
+ * time to restore when adaptive acquisition stops.
+ */
+static int bmp280_acq_adapt_start(struct bmp280_data *data)
+{
+    struct bmp280_adapt *ad = &data->adapt;
+    unsigned int config;
+
+    int ret = regmap_read(data->regmap, BMP280_REG_CONFIG, &config);
+    if(ret < 0)
+        return ret;
+
+    memset(&ad->t_sb, 0, sizeof(*ad) - offsetof(struct bmp280_adapt, t_sb));
+    ad->saved_t_sb = (config & BMP280_T_SB_MASK) >> BMP280_T_SB_SHIFT;
+    ad->t_sb = bmp280_acq_adapt_slowest(data);
+
+    return bmp280_update_field(data, BMP280_REG_CONFIG, BMP280_T_SB_MASK, ad->t_sb << BMP280_T_SB_SHIFT);
+}
+
+/*
+ * Accounts one high-rate sample in the rate and jitter statistics. Jitter is measured
+ * against the mean interval so far rather than the conversion time the timer aims for,
+ * every interval also carries the step's own bus and scheduling overhead, which would
+ * otherwise show up as a constant jitter.
+ */
+static void bmp280_acq_rate_update(struct bmp280_data *data, ktime_t timestamp)
+{
+    struct bmp280_rate_stats *rate = &data->rate;
+
+    spin_lock(&data->read_lock);
+
+    if(rate->samples++ == 0) {
+        rate->start = timestamp;
+    } else {
+        s64 interval = ktime_to_ns(ktime_sub(timestamp, rate->last));
+        s64 mean = div64_s64(ktime_to_ns(ktime_sub(timestamp, rate->start)), rate->samples - 1);
+        u64 jitter = abs(interval - mean);
+
+        rate->interval_min = rate->samples == 2 ? interval : min(rate->interval_min, interval);
+        rate->interval_max = max(rate->interval_max, interval);
+        rate->jitter_sum += jitter;
+        rate->jitter_max = max(rate->jitter_max, jitter);
+    }
+    rate->last = timestamp;
+
+    spin_unlock(&data->read_lock);
+}
+
+/*
+ * Purpose:
+ *   High-rate acquisition step, reads the finished forced conversion and starts the next.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *
+ * Return:
+ *   Time of the next run.
+ *
+ * Details:
+ *   Forced conversions run back to back: right after a result has been read the next
+ *   conversion is started and the next run is timed for its conversion time, measured
+ *   or datasheet (see bmp280_measure_time_us()). At osrs x1/x1 that is at most 6.4 ms
+ *   per sample, far above the ~8 Hz the normal-mode defaults give, and conversions that
+ *   skip temperature (Bmp280-Temperature-Interval) are shorter still. The core lock
+ *   keeps the trigger from racing with a runtime reconfiguration.
+ */
+static ktime_t bmp280_acq_highrate(struct bmp280_data *data)
+{
+    struct bmp280_sample sample;
+    unsigned int ctrl_meas;
+    int ret;
+
+    if(data->hr_armed) {
+        ktime_t start = ktime_get();
+        ret = data->hr_temp ? bmp280_read_raw(data, true, sample.raw) : bmp280_read_press(data, sample.raw);
+        if(ret < 0) {
+            dev_err_ratelimited(data->dev, "Failed to read a high-rate sample\n");
+        } else {
+            sample.timestamp = ktime_get();
+            bmp280_acq_latency_add(data, &data->read_time, ktime_to_ns(ktime_sub(sample.timestamp, start)));
+            if(bmp280_compensate_sample(data, &sample) == 0) {
+                bmp280_publish(data, &sample);
+                bmp280_acq_rate_update(data, sample.timestamp);
+            }
+        }
+    }
+
+    mutex_lock(&data->lock);
+    ret = regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas);
+    if(ret == 0)
+        ret = bmp280_start_forced(data, (ctrl_meas & ~BMP280_MODE_MASK) | BMP280_MODE_FORCED, &data->hr_temp);
+    mutex_unlock(&data->lock);
+
+    data->hr_armed = ret >= 0;
+    if(ret < 0) {
+        dev_err_ratelimited(data->dev, "Failed to start a high-rate conversion\n");
+        return ktime_add_ns(ktime_get(), NSEC_PER_SEC / 10); // Back off on errors
+    }
+
+    return ktime_add_us(ktime_get(), ret);
+}
+
+/*
+ * Runs one step of the active mode and arms the timer for the next, from the work item
+ * or the real-time worker. The sensor is only ever accessed from here, never from the
+ * timer. The timer runs on absolute time, so the next run is aimed at a point in time
+ * the step worked out rather than at an offset from whenever the step finished. The
+ * delay between that point and the step actually starting is the activation latency.
+ */
+static void bmp280_acq_step(struct bmp280_data *data)
+{
+    ktime_t start = ktime_get();
+    ktime_t next;
+
+    if(data->acq_expires)
+        bmp280_acq_latency_add(data, &data->activation, ktime_to_ns(ktime_sub(start, data->acq_expires)));
+
+    switch(READ_ONCE(data->acq_mode)) {
+    case BMP280_ACQ_PERIODIC:
+        next = bmp280_acq_periodic(data, NULL);
+        break;
+    case BMP280_ACQ_ADAPTIVE:
+        next = bmp280_acq_adaptive(data);
+        break;
+    case BMP280_ACQ_HIGHRATE:
+        next = bmp280_acq_highrate(data);
+        break;
+    default:
+        return;
+    }
+
+    data->acq_expires = next;
+    hrtimer_start(&data->acq_timer, next, HRTIMER_MODE_ABS_HARD);
+}
+
+static void bmp280_acq_work(struct work_struct *work)
+{
+    bmp280_acq_step(container_of(work, struct bmp280_data, acq_work));
+}
+
+static void bmp280_acq_kwork(struct kthread_work *work)
+{
+    bmp280_acq_step(container_of(work, struct bmp280_data, acq_kwork));
+}
+
+/* Queues a step on the real-time worker if there is one, on the shared workqueue if not */
+static void bmp280_acq_kick(struct bmp280_data *data)
+{
+    if(data->acq_kworker)
+        kthread_queue_work(data->acq_kworker, &data->acq_kwork);
+    else
+        queue_work(system_highpri_wq, &data->acq_work);
+}
+
+/*
+ * Next step due, hand over to the worker since the bus cannot be used from here. The
+ * timer is a hard one, so even on PREEMPT_RT it fires from the timer interrupt instead of
+ * the softirq thread; both queueing calls only take raw spinlocks and are fine there.
+ */
+static enum hrtimer_restart bmp280_acq_timer(struct hrtimer *timer)
+{
+    struct bmp280_data *data = container_of(timer, struct bmp280_data, acq_timer);
+
+    bmp280_acq_kick(data);
+    return HRTIMER_NORESTART;
+}
+
+static void bmp280_acq_cancel_work(struct bmp280_data *data)
+{
+    cancel_work_sync(&data->acq_work);
+    if(data->acq_kworker)
+        kthread_cancel_work_sync(&data->acq_kwork);
+}
+
+/* Stops whichever acquisition is running, acq_mode must already be BMP280_ACQ_OFF */
+static void bmp280_acq_stop(struct bmp280_data *data)
+{
+    // The work may arm the timer and the timer may queue the work, stop both twice over
+    bmp280_acq_cancel_work(data);
+    hrtimer_cancel(&data->acq_timer);
+    bmp280_acq_cancel_work(data);
+    data->hr_armed = false;
+}
+
+/*
+ * Purpose:
+ *   Moves acquisition onto a dedicated real-time worker or back to the workqueue.
+ *
+ * Parameters:
+ *   @data:     Pointer to the BMP280 driver data.
+ *   @realtime: True for a SCHED_FIFO worker, false for the shared high-priority workqueue.
+ *
+ * Return:
+ *   0 on success, negative error code if the worker could not be set up.
+ *
+ * Details:
+ *   The shared workqueue runs the steps whenever a kworker gets around to them, behind
+ *   whatever else is queued, which shows as activation latency in the millisecond
+ *   range under load. A kthread_worker of its own at a SCHED_FIFO priority preempts all
+ *   normal tasks and typically starts a step within tens of microseconds of the timer.
+ *   The priority is the one sched_set_fifo() gives every in-kernel real-time thread,
+ *   modules cannot pick their own. On I2C the worker carries out its register accesses
+ *   itself rather than queueing them on the normal priority bus scheduler, but it still
+ *   waits whenever another transfer holds the adapter. Running acquisition is stopped
+ *   for the switch and resumed on the new worker, the old worker is only destroyed once
+ *   nothing can queue on it any more.
+ */
+static int bmp280_acq_set_realtime(struct bmp280_data *data, bool realtime)
+{
+    struct kthread_worker *worker = NULL;
+
+    if(realtime) {
+        worker = kthread_create_worker(0, DRIVER_NAME "-%s", dev_name(data->dev));
+        if(IS_ERR(worker))
+            return PTR_ERR(worker);
+
+        sched_set_fifo(worker->task);
+    }
+
+    mutex_lock(&data->acq_lock);
+
+    enum bmp280_acq_mode mode = data->acq_mode;
+    WRITE_ONCE(data->acq_mode, BMP280_ACQ_OFF);
+    bmp280_acq_stop(data);
+
+    struct kthread_worker *old = data->acq_kworker;
+    WRITE_ONCE(data->acq_kworker, worker);
+    WRITE_ONCE(data->acq_realtime, realtime);
+
+    if(mode != BMP280_ACQ_OFF) {
+        data->acq_expires = 0;
+        WRITE_ONCE(data->acq_mode, mode);
+        bmp280_acq_kick(data);
+    }
+
+    mutex_unlock(&data->acq_lock);
+
+    if(old)
+        kthread_destroy_worker(old);
+    return 0;
+}
+
+/*
+ * Purpose:
+ *   Switches the acquisition of a sensor on or off.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *   @mode: New acquisition mode.
+ *
+ * Return:
+ *   0 on success, -EBUSY in forced mode, negative error code if the sensor could not be
+ *   put in normal mode.
+ *
+ * Details:
+ *   The running worker is always stopped first. Periodic acquisition needs the sensor
+ *   converting on its own, so it is put in normal mode before the worker starts.
+ *   High-rate acquisition starts its own forced conversions, a sensor left behind by it
+ *   goes back to the mode it was in before (normal, as forced mode cannot start it),
+ *   which also brings the cached ctrl_meas back in line with the sensor.
+ *   Adaptive acquisition owns t_sb while it runs, it starts at the slowest allowed rate
+ *   and puts the standby time it found back when it stops.
+ */
+static int bmp280_acq_set_mode(struct bmp280_data *data, enum bmp280_acq_mode mode)
+{
+    int ret = 0;
+
+    mutex_lock(&data->acq_lock);
+
+    if(mode == data->acq_mode)
+        goto out;
+
+    // Forced mode keeps the sensor asleep between reads, which acquisition would undo
+    if(mode != BMP280_ACQ_OFF && data->on_demand) {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    enum bmp280_acq_mode old = data->acq_mode;
+    WRITE_ONCE(data->acq_mode, BMP280_ACQ_OFF);
+    bmp280_acq_stop(data);
+
+    if(old == BMP280_ACQ_HIGHRATE)
+        ret = bmp280_update_field(data, BMP280_REG_CTRL_MEAS, BMP280_MODE_MASK, data->hr_saved_mode);
+    else if(old == BMP280_ACQ_ADAPTIVE)
+        ret = bmp280_update_field(data, BMP280_REG_CONFIG, BMP280_T_SB_MASK,
+                                  data->adapt.saved_t_sb << BMP280_T_SB_SHIFT);
+
+    if(mode == BMP280_ACQ_PERIODIC || mode == BMP280_ACQ_ADAPTIVE) {
+        ret = bmp280_update_field(data, BMP280_REG_CTRL_MEAS, BMP280_MODE_MASK, BMP280_MODE_NORMAL);
+        if(ret == 0 && mode == BMP280_ACQ_ADAPTIVE)
+            ret = bmp280_acq_adapt_start(data);
+        if(ret < 0)
+            goto out;
+
+        memset(&data->phase, 0, sizeof(data->phase));
+    } else if(mode == BMP280_ACQ_HIGHRATE) {
+        unsigned int ctrl_meas;
+
+        ret = regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas);
+        if(ret < 0)
+            goto out;
+        data->hr_saved_mode = ctrl_meas & BMP280_MODE_MASK;
+
+        spin_lock(&data->read_lock);
+        memset(&data->rate, 0, sizeof(data->rate));
+        spin_unlock(&data->read_lock);
+    }
+
+    if(mode != BMP280_ACQ_OFF) {
+        spin_lock(&data->read_lock);
+        memset(&data->activation, 0, sizeof(data->activation));
+        memset(&data->read_time, 0, sizeof(data->read_time));
+        spin_unlock(&data->read_lock);
+
+        data->acq_expires = 0;
+        WRITE_ONCE(data->acq_mode, mode);
+        bmp280_acq_kick(data);
+    }
+
+out:
+    mutex_unlock(&data->acq_lock);
+    return ret;
+}
+
+/*
+ * Sysfs attribute selecting the acquisition mode, e.g.
+ * 'echo periodic > /sys/bus/i2c/devices/1-0076/Bmp280-Acquisition' starts fetching every
+ * normal-mode conversion in the background, "adaptive" does the same with the rate
+ * following how fast pressure changes, "highrate" runs forced conversions back to back
+ * and "off" makes every read go to the sensor.
+ */
+static ssize_t acquisition_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%s\n", bmp280_acq_modes[READ_ONCE(data->acq_mode)]);
+}
+
+static ssize_t acquisition_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    int mode = sysfs_match_string(bmp280_acq_modes, buf);
+    if(mode < 0)
+        return mode;
+
+    int ret = bmp280_acq_set_mode(data, mode);
+    return ret < 0 ? ret : count;
+}
+static struct device_attribute dev_attr_acquisition = __ATTR(Bmp280-Acquisition, 0644, acquisition_show, acquisition_store);
+
+/*
+ * Sysfs attribute selecting what runs acquisition, e.g.
+ * 'echo 1 > /sys/bus/i2c/devices/1-0076/Bmp280-Acquisition-Realtime' moves it onto a
+ * dedicated SCHED_FIFO kthread and 'echo 0 > ...' back to the shared workqueue.
+ */
+static ssize_t acquisition_realtime_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%d\n", READ_ONCE(data->acq_realtime));
+}
+
+static ssize_t acquisition_realtime_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    bool realtime;
+
+    int ret = kstrtobool(buf, &realtime);
+    if(ret < 0)
+        return ret;
+
+    ret = bmp280_acq_set_realtime(data, realtime);
+    return ret < 0 ? ret : count;
+}
+static struct device_attribute dev_attr_acquisition_realtime = __ATTR(Bmp280-Acquisition-Realtime, 0644, acquisition_realtime_show, acquisition_realtime_store);
+
+/* Shared show/store helpers of the adaptive acquisition settings */
+static struct bmp280_adapt *bmp280_acq_dev_adapt(struct device *dev)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return &data->adapt;
+}
+
+static ssize_t bmp280_acq_setting_show(char *buf, const unsigned int *field)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(*field));
+}
+
+static ssize_t bmp280_acq_setting_store(const char *buf, size_t count, unsigned int *field)
+{
+    unsigned int value;
+
+    int ret = kstrtouint(buf, 0, &value);
+    if(ret < 0)
+        return ret;
+
+    WRITE_ONCE(*field, value);
+    return count;
+}
+
+/*
+ * Sysfs attributes tuning adaptive acquisition, e.g.
+ * 'echo 100000 > /sys/bus/i2c/devices/1-0076/Bmp280-Adaptive-Min-Period-us' caps the
+ * rate at 10 Hz and 'echo 20 > .../Bmp280-Adaptive-Rise-Pa-s' only speeds up once
+ * pressure changes by more than 20 Pa/s. Bmp280-Adaptive-Fall-Pa-s is the rate of change
+ * below which the rate decays towards Bmp280-Adaptive-Max-Period-us. Periods are
+ * t_measure + t_sb and are rounded to the standby times the sensor supports. Changes
+ * apply from the next step on.
+ */
+static ssize_t adaptive_min_period_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_acq_setting_show(buf, &bmp280_acq_dev_adapt(dev)->min_period_us);
+}
+
+static ssize_t adaptive_min_period_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_acq_setting_store(buf, count, &bmp280_acq_dev_adapt(dev)->min_period_us);
+}
+static struct device_attribute dev_attr_adaptive_min_period = __ATTR(Bmp280-Adaptive-Min-Period-us, 0644, adaptive_min_period_show, adaptive_min_period_store);
+
+static ssize_t adaptive_max_period_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_acq_setting_show(buf, &bmp280_acq_dev_adapt(dev)->max_period_us);
+}
+
+static ssize_t adaptive_max_period_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_acq_setting_store(buf, count, &bmp280_acq_dev_adapt(dev)->max_period_us);
+}
+static struct device_attribute dev_attr_adaptive_max_period = __ATTR(Bmp280-Adaptive-Max-Period-us, 0644, adaptive_max_period_show, adaptive_max_period_store);
+
+static ssize_t adaptive_rise_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_acq_setting_show(buf, &bmp280_acq_dev_adapt(dev)->rise_pa_s);
+}
+
+static ssize_t adaptive_rise_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_acq_setting_store(buf, count, &bmp280_acq_dev_adapt(dev)->rise_pa_s);
+}
+static struct device_attribute dev_attr_adaptive_rise = __ATTR(Bmp280-Adaptive-Rise-Pa-s, 0644, adaptive_rise_show, adaptive_rise_store);
+
+static ssize_t adaptive_fall_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_acq_setting_show(buf, &bmp280_acq_dev_adapt(dev)->fall_pa_s);
+}
+
+static ssize_t adaptive_fall_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_acq_setting_store(buf, count, &bmp280_acq_dev_adapt(dev)->fall_pa_s);
+}
+static struct device_attribute dev_attr_adaptive_fall = __ATTR(Bmp280-Adaptive-Fall-Pa-s, 0644, adaptive_fall_show, adaptive_fall_store);
+
+/*
+ * Sysfs attribute setting how long readers reuse the latest sample, e.g.
+ * 'echo 500000 > /sys/bus/i2c/devices/1-0076/Bmp280-Cache-TTL-us'. "auto" (the default)
+ * follows the measurement period and 0 makes every read go to the sensor. Reading it
+ * shows the TTL in effect.
+ */
+static ssize_t cache_ttl_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    if(READ_ONCE(data->cache_ttl_us) == BMP280_TTL_AUTO)
+        return sysfs_emit(buf, "auto (%u)\n", bmp280_cache_ttl_us(data));
+    return sysfs_emit(buf, "%u\n", READ_ONCE(data->cache_ttl_us));
+}
+
+static ssize_t cache_ttl_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    unsigned int ttl_us;
+
+    if(sysfs_streq(buf, "auto")) {
+        ttl_us = BMP280_TTL_AUTO;
+    } else {
+        int ret = kstrtouint(buf, 0, &ttl_us);
+        if(ret < 0)
+            return ret;
+        if(ttl_us == BMP280_TTL_AUTO)
+            return -EINVAL;
+    }
+
+    WRITE_ONCE(data->cache_ttl_us, ttl_us);
+    return count;
+}
+static struct device_attribute dev_attr_cache_ttl = __ATTR(Bmp280-Cache-TTL-us, 0644, cache_ttl_show, cache_ttl_store);
+
+/* Appends min/avg/max and the log2 histogram of a duration to a Bmp280-Stats buffer */
+static ssize_t bmp280_acq_latency_emit(char *buf, ssize_t len, const char *name, const struct bmp280_latency *lat)
+{
+    u64 avg = lat->count ? div64_u64(lat->sum_ns, lat->count) : 0;
+
+    len += sysfs_emit_at(buf, len, "%s min/avg/max: %lld/%llu/%lldns\n", name, lat->min_ns, avg, lat->max_ns);
+    len += sysfs_emit_at(buf, len, "%s histogram (us): <1:%lu", name, lat->hist[0]);
+    for(unsigned int i = 1; i < BMP280_HIST_BUCKETS - 1; i++)
+        len += sysfs_emit_at(buf, len, " %u:%lu", 1U << (i - 1), lat->hist[i]);
+    len += sysfs_emit_at(buf, len, " >=%u:%lu\n", 1U << (BMP280_HIST_BUCKETS - 2), lat->hist[BMP280_HIST_BUCKETS - 1]);
+
+    return len;
+}
+
+/*
+ * Sysfs show function reporting how readers were served, e.g.
+ * 'cat /sys/bus/i2c/devices/1-0076/Bmp280-Stats'. Coalesced reads are readers that shared
+ * the result of a sensor read already in flight instead of starting their own. The
+ * periodic lines show how well periodic acquisition is locked to the sensor: reads that
+ * found no new conversion, conversions that were never read and the estimated true
+ * period of the sensor next to the nominal one. The rate and interval lines cover
+ * high-rate acquisition since it was last switched on, jitter is the deviation of the
+ * intervals from their mean. The adaptive lines show the
+ * standby time in use, the latest |dP/dt| and how often the rate went up and down.
+ * Reused temperatures are samples whose conversion skipped temperature and were
+ * compensated with the cached t_fine. Deadband suppressed counts samples that were not
+ * delivered to the character device because neither channel moved far enough. The
+ * activation lines show how late acquisition steps started after their timer was due,
+ * the read lines how long fetching the data registers took, both since acquisition was
+ * last switched on. A histogram bucket n counts durations from n up to 2n us. Read times
+ * include waiting for the bus: on a shared I2C adapter a real-time worker still waits
+ * for any transfer already holding the adapter, and that shows up here.
+ */
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    u64 rate_mhz = 0, interval_avg = 0, jitter_avg = 0;
+
+    spin_lock(&data->read_lock);
+    unsigned long coalesced = data->coalesced;
+    unsigned long temp_reused = data->temp_reused;
+    struct bmp280_rate_stats rate = data->rate;
+    struct bmp280_latency activation = data->activation;
+    struct bmp280_latency read_time = data->read_time;
+    spin_unlock(&data->read_lock);
+
+    if(rate.samples > 1) {
+        interval_avg = div64_u64(ktime_to_ns(ktime_sub(rate.last, rate.start)), rate.samples - 1);
+        jitter_avg = div64_u64(rate.jitter_sum, rate.samples - 1);
+        if(interval_avg)
+            rate_mhz = div64_u64(1000ULL * NSEC_PER_SEC, interval_avg);
+    }
+
+    ssize_t len = sysfs_emit(buf, "Coalesced reads: %lu\n", coalesced);
+    len += sysfs_emit_at(buf, len, "Periodic duplicates: %lu\n", READ_ONCE(data->phase.duplicates));
+    len += sysfs_emit_at(buf, len, "Periodic missed: %lu\n", READ_ONCE(data->phase.missed));
+    len += sysfs_emit_at(buf, len, "Periodic period: %lldns (nominal %lldns)\n", READ_ONCE(data->phase.estimate_ns),
+                         (s64)bmp280_period_us(data) * NSEC_PER_USEC);
+    len += sysfs_emit_at(buf, len, "High-rate samples: %llu\n", rate.samples);
+    len += sysfs_emit_at(buf, len, "High-rate: %llu.%03lluHz\n", rate_mhz / 1000, rate_mhz % 1000);
+    len += sysfs_emit_at(buf, len, "Interval min/avg/max: %lld/%llu/%lldns\n",
+                         rate.interval_min, interval_avg, rate.interval_max);
+    len += sysfs_emit_at(buf, len, "Jitter avg/max: %llu/%lluns\n", jitter_avg, rate.jitter_max);
+    u64 slope = READ_ONCE(data->adapt.slope);
+    len += sysfs_emit_at(buf, len, "Adaptive standby: %uus\n", bmp280_standby_time_us(READ_ONCE(data->adapt.t_sb)));
+    len += sysfs_emit_at(buf, len, "Adaptive dP/dt: %llu.%02lluPa/s\n", slope >> 8, ((slope & 0xFF) * 100) >> 8);
+    len += sysfs_emit_at(buf, len, "Adaptive steps up/down: %lu/%lu\n",
+                         READ_ONCE(data->adapt.steps_up), READ_ONCE(data->adapt.steps_down));
+    len += sysfs_emit_at(buf, len, "Reused temperatures: %lu\n", temp_reused);
+    len += sysfs_emit_at(buf, len, "Deadband suppressed: %lu\n", READ_ONCE(data->suppressed));
+    len += sysfs_emit_at(buf, len, "Fifo overruns: %lu\n", READ_ONCE(data->overruns));
+    len = bmp280_acq_latency_emit(buf, len, "Activation", &activation);
+    len = bmp280_acq_latency_emit(buf, len, "Read", &read_time);
+    return len;
+}
+static struct device_attribute dev_attr_stats = __ATTR(Bmp280-Stats, 0444, stats_show, NULL);
+
+static struct attribute *bmp280_acq_attrs[] = {
+    &dev_attr_acquisition.attr,
+    &dev_attr_acquisition_realtime.attr,
+    &dev_attr_cache_ttl.attr,
+    &dev_attr_adaptive_min_period.attr,
+    &dev_attr_adaptive_max_period.attr,
+    &dev_attr_adaptive_rise.attr,
+    &dev_attr_adaptive_fall.attr,
+    &dev_attr_stats.attr,
+    NULL,
+};
+
+const struct attribute_group bmp280_acq_attr_group = {
+    .attrs = bmp280_acq_attrs,
+};
+
+/*
+ * Whether the caller is the real-time acquisition worker of this sensor. The worker
+ * checking this about itself is still alive, so comparing the task is enough.
+ */
+bool bmp280_acq_in_realtime(struct bmp280_data *data)
+{
+    struct kthread_worker *worker = READ_ONCE(data->acq_kworker);
+
+    return worker && worker->task == current;
+}
+
+/* Sets up the sample and the (stopped) worker, called early in bmp280_common_probe() */
+void bmp280_acq_init(struct bmp280_data *data)
+{
+    seqlock_init(&data->latest.lock);
+    mutex_init(&data->acq_lock);
+    data->acq_mode = BMP280_ACQ_OFF;
+    data->cache_ttl_us = BMP280_TTL_AUTO;
+    data->adapt.max_period_us = 2 * USEC_PER_SEC;
+    data->adapt.rise_pa_s = 8;
+    data->adapt.fall_pa_s = 2;
+    INIT_WORK(&data->acq_work, bmp280_acq_work);
+    kthread_init_work(&data->acq_kwork, bmp280_acq_kwork);
+    hrtimer_setup(&data->acq_timer, bmp280_acq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_HARD);
+}
+
+/* Stops the worker for good, the sysfs attributes must already be gone */
+void bmp280_acq_remove(struct bmp280_data *data)
+{
+    bmp280_acq_set_mode(data, BMP280_ACQ_OFF);
+    if(data->acq_kworker)
+        kthread_destroy_worker(data->acq_kworker);
+}
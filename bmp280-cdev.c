@@ -0,0 +1,419 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/slab.h>
+
+#include "bmp280.h"
+
+#define BMP280_FIFO_LEN 256 // Samples buffered per sensor, about 1.6 s of high-rate acquisition
+
+/*
+ * /dev/bmp280-<device>: every published sample (background acquisition, high-rate
+ * acquisition and readers that went to the sensor) is queued in a per-sensor fifo and
+ * read() hands them out as struct bmp280_reading records, see bmp280-uapi.h. With a
+ * deadband set only samples that moved far enough are queued, so blocked readers and
+ * poll() only wake up for meaningful changes. The BMP280_IOC_READ_DEADLINE ioctl gets a
+ * single sample under a latency budget instead.
+ *
+ * Files can stay open after the sensor is removed. The struct bmp280_cdev they point at
+ * lives until the last of them is closed, and once removed is set they no longer touch
+ * the sensor: read() and the ioctl fail with -ENODEV and poll() reports a hangup.
+ */
+
+static void bmp280_cdev_reading(const struct bmp280_sample *sample, struct bmp280_reading *reading)
+{
+    reading->timestamp_ns = ktime_to_ns(sample->timestamp);
+    reading->temperature = sample->temp;
+    reading->pressure = sample->press;
+}
+
+/*
+ * Whether a channel moved past its deadband since the last delivered value. The band is
+ * the wider of the absolute one (abs * scale, in the unit of value) and the relative one.
+ */
+static bool bmp280_cdev_outside(const struct bmp280_deadband *db, s64 value, s64 last, u64 scale)
+{
+    u64 band = max((u64)READ_ONCE(db->abs) * scale,
+                   div_u64((u64)abs(last) * READ_ONCE(db->rel_ppm), 1000000));
+
+    return (u64)abs(value - last) > band;
+}
+
+static bool bmp280_cdev_deadband_set(const struct bmp280_deadband *db)
+{
+    return READ_ONCE(db->abs) || READ_ONCE(db->rel_ppm);
+}
+
+/*
+ * Queues a published sample, called under the latest.lock write lock which makes it the
+ * fifo's only producer. Returns false if the deadband held the sample back. A full fifo
+ * drops the new sample and counts an overrun.
+ *
+ * Without any deadband every sample is delivered. Otherwise a sample is delivered when
+ * a channel with a deadband moved past it, channels without one never trigger delivery.
+ * Pressure is compared in Q24.8, so its absolute band in Pa is scaled by 256.
+ */
+bool bmp280_cdev_push(struct bmp280_data *data, const struct bmp280_sample *sample)
+{
+    struct bmp280_reading reading;
+    bool temp_set = bmp280_cdev_deadband_set(&data->db_temp);
+    bool press_set = bmp280_cdev_deadband_set(&data->db_press);
+
+    if(READ_ONCE(data->db_valid) && (temp_set || press_set) &&
+       !(temp_set && bmp280_cdev_outside(&data->db_temp, sample->temp, data->db_last_temp, 1)) &&
+       !(press_set && bmp280_cdev_outside(&data->db_press, sample->press, data->db_last_press, 256))) {
+        WRITE_ONCE(data->suppressed, data->suppressed + 1);
+        return false;
+    }
+
+    data->db_last_temp = sample->temp;
+    data->db_last_press = sample->press;
+    WRITE_ONCE(data->db_valid, true);
+
+    bmp280_cdev_reading(sample, &reading);
+    if(!kfifo_put(&data->cdev->fifo, reading))
+        WRITE_ONCE(data->overruns, data->overruns + 1);
+    return true;
+}
+
+static void bmp280_cdev_free(struct kref *ref)
+{
+    struct bmp280_cdev *cdev = container_of(ref, struct bmp280_cdev, ref);
+
+    kfifo_free(&cdev->fifo);
+    kfree(cdev);
+}
+
+static int bmp280_cdev_open(struct inode *inode, struct file *file)
+{
+    /*
+     * misc_open() points private_data at the miscdevice, swap it for the character
+     * device. misc_deregister() cannot run concurrently, so the sensor's reference is
+     * still held here.
+     */
+    struct bmp280_cdev *cdev = container_of(file->private_data, struct bmp280_cdev, miscdev);
+
+    kref_get(&cdev->ref);
+    file->private_data = cdev;
+    return nonseekable_open(inode, file);
+}
+
+static int bmp280_cdev_release(struct inode *inode, struct file *file)
+{
+    struct bmp280_cdev *cdev = file->private_data;
+
+    kref_put(&cdev->ref, bmp280_cdev_free);
+    return 0;
+}
+
+/*
+ * Purpose:
+ *   Hands queued samples to userspace, oldest first.
+ *
+ * Parameters:
+ *   @file:  The open character device.
+ *   @buf:   User buffer, filled with whole struct bmp280_reading records.
+ *   @count: Size of buf, at least one record.
+ *   @ppos:  Unused, the device is not seekable.
+ *
+ * Return:
+ *   Number of bytes copied, -ENODEV once the sensor is gone, or another negative error
+ *   code.
+ *
+ * Details:
+ *   Blocks until at least one sample is queued unless the file was opened O_NONBLOCK.
+ *   Samples queued before the sensor was removed are still handed out.
+ */
+static ssize_t bmp280_cdev_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+    struct bmp280_cdev *cdev = file->private_data;
+    unsigned int copied;
+    int ret;
+
+    if(count < sizeof(struct bmp280_reading))
+        return -EINVAL;
+
+    if(mutex_lock_interruptible(&cdev->fifo_lock))
+        return -ERESTARTSYS;
+
+    while(kfifo_is_empty(&cdev->fifo)) {
+        bool removed = cdev->removed;
+
+        mutex_unlock(&cdev->fifo_lock);
+
+        if(removed)
+            return -ENODEV;
+        if(file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(cdev->fifo_wait, !kfifo_is_empty(&cdev->fifo) || READ_ONCE(cdev->removed));
+        if(ret < 0)
+            return ret;
+
+        if(mutex_lock_interruptible(&cdev->fifo_lock))
+            return -ERESTARTSYS;
+    }
+
+    ret = kfifo_to_user(&cdev->fifo, buf, rounddown(count, sizeof(struct bmp280_reading)), &copied);
+    mutex_unlock(&cdev->fifo_lock);
+
+    return ret < 0 ? ret : copied;
+}
+
+/* Readable once a sample is queued, the deadband keeps the wakeups to real changes */
+static __poll_t bmp280_cdev_poll(struct file *file, poll_table *wait)
+{
+    struct bmp280_cdev *cdev = file->private_data;
+    __poll_t mask = 0;
+
+    poll_wait(file, &cdev->fifo_wait, wait);
+
+    if(!kfifo_is_empty(&cdev->fifo))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if(READ_ONCE(cdev->removed))
+        mask |= EPOLLHUP | EPOLLERR;
+    return mask;
+}
+
+/* osrs code of ctrl_meas to oversampling ratio, codes 5-7 all mean x16 */
+static u8 bmp280_cdev_ratio(unsigned int code)
+{
+    return code ? 1 << (min(code, 5U) - 1) : 0;
+}
+
+/*
+ * Purpose:
+ *   Handles the ioctls of the character device, see bmp280-uapi.h.
+ *
+ * Parameters:
+ *   @file: The open character device.
+ *   @cmd:  BMP280_IOC_READ_DEADLINE.
+ *   @arg:  User pointer to a struct bmp280_deadline_read.
+ *
+ * Return:
+ *   0 on success, -ENOTTY for unknown commands, -ENODEV once the sensor is gone, other
+ *   negative error codes from bmp280_read_deadline() or the user copy.
+ *
+ * Details:
+ *   The fifo is not touched, the sample still gets queued there like every published
+ *   sample. fifo_lock is held across the read so the sensor cannot be removed under it,
+ *   which also keeps read() waiting for at most the deadline.
+ */
+static long bmp280_cdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct bmp280_cdev *cdev = file->private_data;
+    struct bmp280_deadline_read __user *uarg = (void __user *)arg;
+    struct bmp280_deadline_read req;
+    struct bmp280_sample sample;
+    u8 osrs;
+    int ret;
+
+    if(cmd != BMP280_IOC_READ_DEADLINE)
+        return -ENOTTY;
+
+    if(copy_from_user(&req, uarg, sizeof(req)))
+        return -EFAULT;
+
+    if(mutex_lock_interruptible(&cdev->fifo_lock))
+        return -ERESTARTSYS;
+    if(cdev->removed)
+        ret = -ENODEV;
+    else
+        ret = bmp280_read_deadline(cdev->data, req.max_staleness_us, req.deadline_us, &sample, &osrs);
+    mutex_unlock(&cdev->fifo_lock);
+    if(ret < 0)
+        return ret;
+
+    bmp280_cdev_reading(&sample, &req.reading);
+    req.temperature_oversampling = bmp280_cdev_ratio((osrs & BMP280_OSRS_T_MASK) >> BMP280_OSRS_T_SHIFT);
+    req.pressure_oversampling = bmp280_cdev_ratio((osrs & BMP280_OSRS_P_MASK) >> BMP280_OSRS_P_SHIFT);
+    memset(req.reserved, 0, sizeof(req.reserved));
+
+    return copy_to_user(uarg, &req, sizeof(req)) ? -EFAULT : 0;
+}
+
+static const struct file_operations bmp280_cdev_fops = {
+    .owner = THIS_MODULE,
+    .open = bmp280_cdev_open,
+    .release = bmp280_cdev_release,
+    .read = bmp280_cdev_read,
+    .poll = bmp280_cdev_poll,
+    .unlocked_ioctl = bmp280_cdev_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+};
+
+/* Shared show/store helpers of the deadband settings */
+static ssize_t bmp280_cdev_deadband_show(char *buf, const unsigned int *field)
+{
+    return sysfs_emit(buf, "%u\n", READ_ONCE(*field));
+}
+
+static ssize_t bmp280_cdev_deadband_store(struct device *dev, const char *buf, size_t count,
+                                          unsigned int *field, unsigned int max)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    unsigned int value;
+
+    int ret = kstrtouint(buf, 0, &value);
+    if(ret < 0)
+        return ret;
+    if(value > max)
+        return -EINVAL;
+
+    WRITE_ONCE(*field, value);
+    // Deliver the next sample unconditionally, it becomes the new reference
+    WRITE_ONCE(data->db_valid, false);
+    return count;
+}
+
+static struct bmp280_data *bmp280_cdev_dev_data(struct device *dev)
+{
+    return dev_get_drvdata(dev);
+}
+
+/*
+ * Sysfs attributes setting the deadbands of /dev/bmp280-<device>, e.g.
+ * 'echo 10 > /sys/bus/i2c/devices/1-0076/Bmp280-Deadband-Temperature' only delivers a
+ * sample once temperature moved by more than 0.1 °C since the last delivered one, and
+ * 'echo 20 > .../Bmp280-Deadband-Pressure' once pressure moved by more than 20 Pa. The
+ * -ppm variants are relative to the last delivered value (10 ppm of 100000 Pa is 1 Pa),
+ * a channel with both set uses the wider band. A channel without any deadband never
+ * triggers delivery on its own, with no deadband at all every sample is delivered.
+ */
+static ssize_t deadband_temperature_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_cdev_deadband_show(buf, &bmp280_cdev_dev_data(dev)->db_temp.abs);
+}
+
+static ssize_t deadband_temperature_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_cdev_deadband_store(dev, buf, count, &bmp280_cdev_dev_data(dev)->db_temp.abs, 10000); // 100 °C
+}
+static struct device_attribute dev_attr_deadband_temperature = __ATTR(Bmp280-Deadband-Temperature, 0644, deadband_temperature_show, deadband_temperature_store);
+
+static ssize_t deadband_temperature_ppm_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_cdev_deadband_show(buf, &bmp280_cdev_dev_data(dev)->db_temp.rel_ppm);
+}
+
+static ssize_t deadband_temperature_ppm_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_cdev_deadband_store(dev, buf, count, &bmp280_cdev_dev_data(dev)->db_temp.rel_ppm, 1000000);
+}
+static struct device_attribute dev_attr_deadband_temperature_ppm = __ATTR(Bmp280-Deadband-Temperature-ppm, 0644, deadband_temperature_ppm_show, deadband_temperature_ppm_store);
+
+static ssize_t deadband_pressure_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_cdev_deadband_show(buf, &bmp280_cdev_dev_data(dev)->db_press.abs);
+}
+
+static ssize_t deadband_pressure_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_cdev_deadband_store(dev, buf, count, &bmp280_cdev_dev_data(dev)->db_press.abs, 110000); // Full range
+}
+static struct device_attribute dev_attr_deadband_pressure = __ATTR(Bmp280-Deadband-Pressure, 0644, deadband_pressure_show, deadband_pressure_store);
+
+static ssize_t deadband_pressure_ppm_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_cdev_deadband_show(buf, &bmp280_cdev_dev_data(dev)->db_press.rel_ppm);
+}
+
+static ssize_t deadband_pressure_ppm_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_cdev_deadband_store(dev, buf, count, &bmp280_cdev_dev_data(dev)->db_press.rel_ppm, 1000000);
+}
+static struct device_attribute dev_attr_deadband_pressure_ppm = __ATTR(Bmp280-Deadband-Pressure-ppm, 0644, deadband_pressure_ppm_show, deadband_pressure_ppm_store);
+
+static struct attribute *bmp280_cdev_attrs[] = {
+    &dev_attr_deadband_temperature.attr,
+    &dev_attr_deadband_temperature_ppm.attr,
+    &dev_attr_deadband_pressure.attr,
+    &dev_attr_deadband_pressure_ppm.attr,
+    NULL,
+};
+
+const struct attribute_group bmp280_cdev_attr_group = {
+    .attrs = bmp280_cdev_attrs,
+};
+
+/*
+ * Purpose:
+ *   Creates the character device of a sensor.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *
+ * Return:
+ *   0 on success, negative error code on failure.
+ *
+ * Details:
+ *   The device is named after the I2C/SPI device, e.g. /dev/bmp280-1-0076, so several
+ *   sensors can be told apart.
+ */
+int bmp280_cdev_register(struct bmp280_data *data)
+{
+    struct bmp280_cdev *cdev = kzalloc(sizeof(*cdev), GFP_KERNEL);
+    if(!cdev)
+        return -ENOMEM;
+
+    kref_init(&cdev->ref);
+    cdev->data = data;
+    mutex_init(&cdev->fifo_lock);
+    init_waitqueue_head(&cdev->fifo_wait);
+
+    int ret = kfifo_alloc(&cdev->fifo, BMP280_FIFO_LEN, GFP_KERNEL);
+    if(ret < 0)
+        goto err_free;
+
+    cdev->miscdev.minor = MISC_DYNAMIC_MINOR;
+    cdev->miscdev.name = devm_kasprintf(data->dev, GFP_KERNEL, DRIVER_NAME "-%s", dev_name(data->dev));
+    cdev->miscdev.fops = &bmp280_cdev_fops;
+    cdev->miscdev.parent = data->dev;
+    if(!cdev->miscdev.name) {
+        ret = -ENOMEM;
+        goto err_free;
+    }
+
+    // Set before the device can be opened, bmp280_publish() may already run
+    data->cdev = cdev;
+
+    ret = misc_register(&cdev->miscdev);
+    if(ret < 0)
+        goto err_free;
+
+    return 0;
+
+err_free:
+    data->cdev = NULL;
+    kref_put(&cdev->ref, bmp280_cdev_free);
+    return ret;
+}
+
+/*
+ * Purpose:
+ *   Removes the character device of a sensor that is going away.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *
+ * Details:
+ *   Called once nothing publishes samples any more. Marking the device removed under
+ *   fifo_lock waits for a running ioctl, wakes every blocked reader and poller so they
+ *   see -ENODEV or a hangup, and the fifo itself is freed with the last open file.
+ */
+void bmp280_cdev_unregister(struct bmp280_data *data)
+{
+    struct bmp280_cdev *cdev = data->cdev;
+
+    mutex_lock(&cdev->fifo_lock);
+    cdev->removed = true;
+    cdev->data = NULL;
+    mutex_unlock(&cdev->fifo_lock);
+
+    wake_up_interruptible_all(&cdev->fifo_wait);
+    misc_deregister(&cdev->miscdev);
+
+    data->cdev = NULL;
+    kref_put(&cdev->ref, bmp280_cdev_free);
+}
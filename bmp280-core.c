@@ -0,0 +1,1453 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/device.h>
+#include <linux/delay.h>
+#include <linux/moduleparam.h>
+
+#include "bmp280.h"
+
+static bool measure_timing;
+module_param(measure_timing, bool, 0444);
+MODULE_PARM_DESC(measure_timing, "Measure the real conversion time of every sensor at probe (default: use the datasheet maxima)");
+
+/*
+ * Register map of the BMP280 as seen by regmap:
+ *   • The calibration block, chip id, ctrl_meas and config never change behind our back,
+ *     so they are cached. Writing an unchanged value through regmap_update_bits() and
+ *     reading them back costs no bus traffic.
+ *   • status and the 0xF7-0xFC data block are updated by the sensor itself and are
+ *     therefore volatile. The reset register is write-only and never worth caching.
+ */
+static bool bmp280_is_writeable_reg(struct device *dev, unsigned int reg)
+{
+    switch(reg) {
+    case BMP280_REG_RESET:
+    case BMP280_REG_CTRL_MEAS:
+    case BMP280_REG_CONFIG:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool bmp280_is_readable_reg(struct device *dev, unsigned int reg)
+{
+    switch(reg) {
+    case BMP280_CALIB_REG ... BMP280_CALIB_REG + BMP280_CALIB_LEN - 1:
+    case BMP280_REG_CHIP_ID:
+    case BMP280_REG_RESET:
+    case BMP280_REG_STATUS:
+    case BMP280_REG_CTRL_MEAS:
+    case BMP280_REG_CONFIG:
+    case BMP280_DATA_REG ... BMP280_REG_TEMP_XLSB:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool bmp280_is_volatile_reg(struct device *dev, unsigned int reg)
+{
+    switch(reg) {
+    case BMP280_REG_RESET:
+    case BMP280_REG_STATUS:
+    case BMP280_DATA_REG ... BMP280_REG_TEMP_XLSB:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const struct regmap_config bmp280_regmap_config = {
+    .reg_bits = 8,
+    .val_bits = 8,
+    .max_register = BMP280_REG_TEMP_XLSB,
+    .writeable_reg = bmp280_is_writeable_reg,
+    .readable_reg = bmp280_is_readable_reg,
+    .volatile_reg = bmp280_is_volatile_reg,
+    .cache_type = REGCACHE_RBTREE,
+    .can_multi_write = true, // Register/value pairs go out back to back in a single message
+};
+
+/*
+ * Datasheet values behind the ctrl_meas/config register codes, the index into each table
+ * is the register code. The runtime settings files take and show these values:
+ *   • Bmp280-Temperature-Oversampling / Bmp280-Pressure-Oversampling: 0 (skipped), 1, 2, 4, 8, 16
+ *   • Bmp280-Filter: IIR filter coefficient 0 (off), 2, 4, 8, 16
+ *   • Bmp280-Standby-us: normal mode standby time t_sb in microseconds
+ */
+static const unsigned int bmp280_oversampling_ratios[] = { 0, 1, 2, 4, 8, 16 };
+static const unsigned int bmp280_filter_coefficients[] = { 0, 2, 4, 8, 16 };
+static const unsigned int bmp280_standby_us[] = { 500, 62500, 125000, 250000, 500000, 1000000, 2000000, 4000000 };
+
+/*
+ * Purpose:
+ *   Maximum time one measurement takes for a given ctrl_meas setting.
+ *
+ * Parameters:
+ *   @ctrl_meas: Value of the ctrl_meas register, only osrs_t and osrs_p are looked at.
+ *
+ * Return:
+ *   Measurement time in microseconds.
+ *
+ * Details:
+ *   Datasheet appendix B: t_measure,max = 1.25 + 2.3 * T_os + (2.3 * P_os + 0.575) ms,
+ *   where T_os/P_os are the oversampling ratios and the pressure term drops out when
+ *   pressure measurement is skipped. Codes 5-7 all mean x16.
+ */
+static unsigned int bmp280_measure_time_max_us(u8 ctrl_meas)
+{
+    unsigned int osrs_t = min_t(unsigned int, (ctrl_meas & BMP280_OSRS_T_MASK) >> BMP280_OSRS_T_SHIFT,
+                                ARRAY_SIZE(bmp280_oversampling_ratios) - 1);
+    unsigned int osrs_p = min_t(unsigned int, (ctrl_meas & BMP280_OSRS_P_MASK) >> BMP280_OSRS_P_SHIFT,
+                                ARRAY_SIZE(bmp280_oversampling_ratios) - 1);
+
+    unsigned int us = 1250 + 2300 * bmp280_oversampling_ratios[osrs_t];
+    if(osrs_p)
+        us += 2300 * bmp280_oversampling_ratios[osrs_p] + 575;
+
+    return us;
+}
+
+/*
+ * Purpose:
+ *   Time one measurement takes on this particular sensor.
+ *
+ * Parameters:
+ *   @data:      Pointer to the BMP280 driver data.
+ *   @ctrl_meas: Value of the ctrl_meas register, only osrs_t and osrs_p are looked at.
+ *
+ * Return:
+ *   Measurement time in microseconds.
+ *
+ * Details:
+ *   The datasheet maximum, scaled down by what bmp280_measure_timing() found the sensor
+ *   to actually need. Every path that waits for or schedules around a conversion uses
+ *   this, so a measured sensor gets shorter waits everywhere.
+ */
+unsigned int bmp280_measure_time_us(struct bmp280_data *data, u8 ctrl_meas)
+{
+    unsigned int us = bmp280_measure_time_max_us(ctrl_meas);
+    unsigned int scale = READ_ONCE(data->t_scale);
+
+    return scale ? DIV_ROUND_UP(us * scale, 1000) : us;
+}
+
+/* t_sb of a standby code in microseconds */
+unsigned int bmp280_standby_time_us(unsigned int t_sb)
+{
+    return bmp280_standby_us[min_t(unsigned int, t_sb, ARRAY_SIZE(bmp280_standby_us) - 1)];
+}
+
+/*
+ * Purpose:
+ *   Time between two normal-mode measurements for the active settings.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *
+ * Return:
+ *   t_measure + t_sb in microseconds, 0 before the sensor was first configured.
+ *
+ * Details:
+ *   Datasheet section 3.6.3: in normal mode a measurement is followed by the standby
+ *   time t_sb, so a new result lands in the data registers once per t_measure + t_sb.
+ *   Readers deciding whether the latest sample is still fresh ask for this on every
+ *   read, so it is worked out whenever ctrl_meas, config or the measured conversion
+ *   time change (bmp280_period_set()) and read here without taking any lock.
+ */
+unsigned int bmp280_period_us(struct bmp280_data *data)
+{
+    return READ_ONCE(data->period_us);
+}
+
+/* Recomputes period_us for a ctrl_meas/config pair just written, core lock held */
+static void bmp280_period_set(struct bmp280_data *data, u8 ctrl_meas, u8 config)
+{
+    WRITE_ONCE(data->period_us, bmp280_measure_time_us(data, ctrl_meas) +
+               bmp280_standby_time_us((config & BMP280_T_SB_MASK) >> BMP280_T_SB_SHIFT));
+}
+
+/* Recomputes period_us from the cached registers after t_scale changed, core lock held */
+static void bmp280_period_refresh(struct bmp280_data *data)
+{
+    unsigned int ctrl_meas, config;
+
+    if(regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas) == 0 &&
+       regmap_read(data->regmap, BMP280_REG_CONFIG, &config) == 0)
+        bmp280_period_set(data, ctrl_meas, config);
+}
+
+/*
+ * Purpose:
+ *   Applies a new ctrl_meas/config pair as one atomic write sequence.
+ *
+ * Parameters:
+ *   @data:      Pointer to the BMP280 driver data.
+ *   @ctrl_meas: New value of the ctrl_meas (0xF4) register, including the mode bits.
+ *   @config:    New value of the config (0xF5) register.
+ *
+ * Return:
+ *   0 on success, negative error code if sensor communication fails.
+ *
+ * Details:
+ *   The datasheet warns that writes to config in normal mode may be ignored, so the
+ *   sensor is put to sleep first, config is written and ctrl_meas then restarts the
+ *   measurement with the requested mode. The BMP280 accepts several register/value
+ *   pairs in one write, so regmap sends sleep -> config -> ctrl_meas as a single I2C
+ *   message (three transactions on byte-only adapters), keeping the window in which the
+ *   sensor produces no data as short as the bus allows.
+ *
+ *   A forced conversion is one-shot and the sensor is back asleep once it finished, but
+ *   the regmap cache keeps the mode = 01 it was started with. Replaying that would start
+ *   a conversion nobody asked for, so any mode other than normal is written as sleep.
+ */
+static int bmp280_reconfigure(struct bmp280_data *data, u8 ctrl_meas, u8 config)
+{
+    if((ctrl_meas & BMP280_MODE_MASK) != BMP280_MODE_NORMAL)
+        ctrl_meas = (ctrl_meas & ~BMP280_MODE_MASK) | BMP280_MODE_SLEEP;
+
+    const struct reg_sequence seq[] = {
+        { BMP280_REG_CTRL_MEAS, (ctrl_meas & ~BMP280_MODE_MASK) | BMP280_MODE_SLEEP },
+        { BMP280_REG_CONFIG, config | data->config_flags },
+        { BMP280_REG_CTRL_MEAS, ctrl_meas },
+    };
+
+    int ret = regmap_multi_reg_write(data->regmap, seq, ARRAY_SIZE(seq));
+    if(ret == 0)
+        bmp280_period_set(data, ctrl_meas, config);
+    return ret;
+}
+
+/*
+ * Purpose:
+ *   Replaces one bit field of ctrl_meas or config at runtime.
+ *
+ * Parameters:
+ *   @data:  Pointer to the BMP280 driver data.
+ *   @reg:   BMP280_REG_CTRL_MEAS or BMP280_REG_CONFIG.
+ *   @mask:  Mask of the field inside the register.
+ *   @value: New field value, already shifted into place.
+ *
+ * Return:
+ *   0 on success, negative error code if sensor communication fails.
+ *
+ * Details:
+ *   Both registers come out of the regmap cache. Nothing is written if the field
+ *   already holds the requested value, otherwise the pair is rewritten through
+ *   bmp280_reconfigure().
+ */
+int bmp280_update_field(struct bmp280_data *data, unsigned int reg, u8 mask, u8 value)
+{
+    unsigned int ctrl_meas, config;
+
+    mutex_lock(&data->lock);
+
+    int ret = regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas);
+    if(ret == 0)
+        ret = regmap_read(data->regmap, BMP280_REG_CONFIG, &config);
+    if(ret < 0)
+        goto out;
+
+    unsigned int *target = reg == BMP280_REG_CONFIG ? &config : &ctrl_meas;
+    if((*target & mask) == value)
+        goto out;
+    *target = (*target & ~mask) | value;
+
+    ret = bmp280_reconfigure(data, ctrl_meas, config);
+
+out:
+    mutex_unlock(&data->lock);
+    return ret;
+}
+
+/*
+ * Purpose:
+ *   Works out the smallest contiguous block of data registers that still carries every
+ *   bit of information for the active oversampling setting.
+ *
+ * Parameters:
+ *   @data:       Pointer to the BMP280 driver data.
+ *   @want_press: True when pressure is needed as well, false for temperature-only reads.
+ *   @reg:        Output, first register to read.
+ *   @len:        Output, number of registers to read.
+ *
+ * Return:
+ *   0 on success, negative error code if ctrl_meas could not be read.
+ *
+ * Details:
+ *   ctrl_meas and config come out of the regmap cache, so this costs no bus traffic.
+ *   At osrs x1 (or skipped) with the IIR filter off a channel has 16-bit resolution and
+ *   its xlsb register holds no information. With the filter on, every channel it is
+ *   applied to has 20-bit resolution whatever the oversampling, so xlsb is always
+ *   needed then. Temperature is the tail of the block, so temp_xlsb (0xFC) is simply not
+ *   read when it is empty. press_xlsb (0xF9) sits in the middle of the block and dropping it would take a
+ *   second transaction, which costs more bus time than the byte it saves. Temperature-only
+ *   reads start at temp_msb (0xFA) and never touch the pressure registers.
+ */
+int bmp280_data_window(struct bmp280_data *data, bool want_press, u8 *reg, size_t *len)
+{
+    unsigned int ctrl_meas, config;
+    int ret = regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas);
+    if(ret < 0)
+        return ret;
+    ret = regmap_read(data->regmap, BMP280_REG_CONFIG, &config);
+    if(ret < 0)
+        return ret;
+
+    u8 last = BMP280_REG_TEMP_XLSB;
+    if(!(config & BMP280_FILTER_MASK) &&
+       ((ctrl_meas & BMP280_OSRS_T_MASK) >> BMP280_OSRS_T_SHIFT) <= BMP280_OSRS_X1)
+        last = BMP280_REG_TEMP_LSB;
+
+    *reg = want_press ? BMP280_DATA_REG : BMP280_REG_TEMP_MSB;
+    *len = last - *reg + 1;
+
+    return 0;
+}
+
+/*
+ * Purpose:
+ *   Reads the raw data registers needed for a sample into a zero-filled 0xF7-0xFC image.
+ *
+ * Parameters:
+ *   @data:       Pointer to the BMP280 driver data.
+ *   @want_press: True to read pressure and temperature, false for temperature only.
+ *   @raw:        Output buffer laid out like the 0xF7-0xFC block; registers that were
+ *                not read are left as zero.
+ *
+ * Return:
+ *   0 on success, negative error code if sensor communication fails.
+ */
+int bmp280_read_raw(struct bmp280_data *data, bool want_press, u8 raw[BMP280_DATA_LEN])
+{
+    u8 reg;
+    size_t len;
+    int ret = bmp280_data_window(data, want_press, &reg, &len);
+    if(ret < 0)
+        return ret;
+
+    memset(raw, 0, BMP280_DATA_LEN);
+    return regmap_bulk_read(data->regmap, reg, raw + (reg - BMP280_DATA_REG), len);
+}
+
+/*
+ * Purpose:
+ *   Reads the result of a conversion that skipped temperature.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *   @raw:  Output buffer laid out like the 0xF7-0xFC block, see bmp280_read_raw().
+ *
+ * Return:
+ *   0 on success, negative error code if sensor communication fails.
+ *
+ * Details:
+ *   Pressure is the head of the block, so the read stops before the temperature
+ *   registers, and before press_xlsb at osrs_p x1 with the IIR filter off, see
+ *   bmp280_data_window(). The temperature part of raw is
+ *   filled in with what the sensor would have returned, the 0x80000 skipped value.
+ */
+int bmp280_read_press(struct bmp280_data *data, u8 raw[BMP280_DATA_LEN])
+{
+    unsigned int ctrl_meas, config;
+    int ret = regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas);
+    if(ret < 0)
+        return ret;
+    ret = regmap_read(data->regmap, BMP280_REG_CONFIG, &config);
+    if(ret < 0)
+        return ret;
+
+    u8 last = BMP280_REG_PRESS_XLSB;
+    if(!(config & BMP280_FILTER_MASK) &&
+       ((ctrl_meas & BMP280_OSRS_P_MASK) >> BMP280_OSRS_P_SHIFT) <= BMP280_OSRS_X1)
+        last = BMP280_REG_PRESS_LSB;
+
+    memset(raw, 0, BMP280_DATA_LEN);
+    raw[3] = BMP280_ADC_SKIPPED >> 12;
+    return regmap_bulk_read(data->regmap, BMP280_DATA_REG, raw, last - BMP280_DATA_REG + 1);
+}
+
+/*
+ * Purpose:
+ *   Bosch's integer temperature compensation (datasheet section 8.2).
+ *
+ * Parameters:
+ *   @data:   Pointer to the BMP280 driver data holding the calibration constants.
+ *   @adc_T:  Raw 20-bit temperature reading.
+ *   @t_fine: Output, fine temperature carried over into the pressure compensation.
+ *
+ * Return:
+ *   Temperature in hundredths of a degree Celsius.
+ */
+static s32 bmp280_compensate_temp(struct bmp280_data *data, s32 adc_T, s32 *t_fine)
+{
+    s32 var1, var2;
+    var1 = ((((adc_T >> 3) - ((int32_t)data->dig_T1 << 1))) * ((int32_t)data->dig_T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((int32_t)data->dig_T1)) * ((adc_T >> 4) - ((int32_t)data->dig_T1))) >> 12) * ((int32_t)data->dig_T3)) >> 14;
+
+    *t_fine =  var1 + var2;
+    return (*t_fine * 5 + 128) >> 8;
+}
+
+/*
+ * Purpose:
+ *   Bosch's 64-bit integer pressure compensation (datasheet section 8.2).
+ *
+ * Parameters:
+ *   @data:   Pointer to the BMP280 driver data holding the calibration constants.
+ *   @adc_P:  Raw 20-bit pressure reading.
+ *   @t_fine: Fine temperature from bmp280_compensate_temp().
+ *
+ * Return:
+ *   Pressure in Pa as unsigned Q24.8 fixed point, or 0 if the calibration would make
+ *   the formula divide by zero.
+ */
+static u32 bmp280_compensate_press(struct bmp280_data *data, s32 adc_P, s32 t_fine)
+{
+    s64 var1, var2, P;
+
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)data->dig_P6;
+    var2 = var2 + ((var1 * (int64_t)data->dig_P5) << 17);
+    var2 = var2 + (((int64_t)data->dig_P4) << 35);
+    var1 = ((var1 * var1 * (int64_t)data->dig_P3) >> 8) + ((var1 * (int64_t)data->dig_P2) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)data->dig_P1) >> 33;
+
+    if (var1 == 0)
+        return 0; // avoid exception caused by division by zero
+
+    P = 1048576 - adc_P;
+    P = div64_s64((((P << 31) - var2) * 3125), var1);
+    var1 = (((int64_t)data->dig_P9) * (P >> 13) * (P >> 13)) >> 25;
+    var2 = (((int64_t)data->dig_P8) * P) >> 19;
+    P = ((P + var1 + var2) >> 8) + (((int64_t)data->dig_P7) << 4);
+
+    return P;
+}
+
+/* Raw 20-bit readings are stored msb, lsb, xlsb[7:4] */
+static s32 bmp280_raw_to_adc(const u8 *raw)
+{
+    return (raw[0] << 12) | (raw[1] << 4) | (raw[2] >> 4);
+}
+
+/*
+ * Purpose:
+ *   Turns the 0xF7-0xFC register image of a sample into compensated temperature and
+ *   pressure, the one place every read path compensates through.
+ *
+ * Parameters:
+ *   @data:   Pointer to the BMP280 driver data holding the calibration constants.
+ *   @sample: Sample with raw filled in, temp, press and t_fine are set.
+ *
+ * Return:
+ *   0 on success, -ENODATA if temperature was skipped and has never been measured, in
+ *   which case neither channel can be compensated.
+ *
+ * Details:
+ *   A channel whose osrs is 0 reads as 0x80000. A skipped temperature takes temperature
+ *   and t_fine from the last sample that measured it, every measured one refreshes that
+ *   cache. A skipped pressure is reported as 0, which no real reading can be, and shown
+ *   as unavailable.
+ */
+int bmp280_compensate_sample(struct bmp280_data *data, struct bmp280_sample *sample)
+{
+    s32 adc_T = bmp280_raw_to_adc(sample->raw + 3);
+    s32 adc_P = bmp280_raw_to_adc(sample->raw);
+
+    if(adc_T == BMP280_ADC_SKIPPED) {
+        spin_lock(&data->read_lock);
+        if(!data->t_fine_stamp) {
+            spin_unlock(&data->read_lock);
+            return -ENODATA;
+        }
+        sample->temp = data->temp_cached;
+        sample->t_fine = data->t_fine_cached;
+        data->temp_reused++;
+        spin_unlock(&data->read_lock);
+    } else {
+        sample->temp = bmp280_compensate_temp(data, adc_T, &sample->t_fine);
+
+        spin_lock(&data->read_lock);
+        data->temp_cached = sample->temp;
+        data->t_fine_cached = sample->t_fine;
+        data->t_fine_stamp = ktime_get();
+        spin_unlock(&data->read_lock);
+    }
+
+    sample->press = adc_P == BMP280_ADC_SKIPPED ? 0 : bmp280_compensate_press(data, adc_P, sample->t_fine);
+    return 0;
+}
+
+/*
+ * Purpose:
+ *   Measures how long conversions really take on this sensor.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *
+ * Return:
+ *   0 on success, -EBUSY while acquisition runs, other negative error codes if sensor
+ *   communication fails or a conversion never finishes.
+ *
+ * Details:
+ *   Runs one forced conversion per symmetric oversampling setting (x1/x1 .. x16/x16)
+ *   and polls the measuring bit of the status register until it clears, starting at
+ *   half the datasheet time. The clock starts before the ctrl_meas write goes out, so
+ *   bus latency only ever makes a result longer. The largest measured/datasheet ratio
+ *   becomes the scale bmp280_measure_time_us() applies to every setting, capped at the
+ *   datasheet maximum. A sensor in normal mode may be halfway through a conversion of
+ *   its own, which would make the first measurement too long, so it is put to sleep
+ *   first and given the datasheet time of its current setting to finish. ctrl_meas is
+ *   restored afterwards. The acquisition lock is held throughout so acquisition cannot
+ *   start in the middle, the core lock keeps reconfiguration out.
+ */
+static int bmp280_measure_timing(struct bmp280_data *data)
+{
+    unsigned int measured_us[ARRAY_SIZE(data->t_measured_us)] = { 0 };
+    unsigned int ctrl_meas, status, scale = 0;
+    int ret;
+
+    mutex_lock(&data->acq_lock);
+
+    if(data->acq_mode != BMP280_ACQ_OFF) {
+        mutex_unlock(&data->acq_lock);
+        return -EBUSY;
+    }
+
+    mutex_lock(&data->lock);
+
+    ret = regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas);
+    if(ret < 0)
+        goto out;
+
+    ret = regmap_write(data->regmap, BMP280_REG_CTRL_MEAS, (ctrl_meas & ~BMP280_MODE_MASK) | BMP280_MODE_SLEEP);
+    if(ret < 0)
+        goto restore;
+
+    unsigned int settle_us = bmp280_measure_time_max_us(ctrl_meas);
+    usleep_range(settle_us, settle_us + settle_us / 8);
+
+    for(unsigned int code = BMP280_OSRS_X1; code < ARRAY_SIZE(bmp280_oversampling_ratios); code++) {
+        u8 forced = (code << BMP280_OSRS_T_SHIFT) | (code << BMP280_OSRS_P_SHIFT) | BMP280_MODE_FORCED;
+        unsigned int max_us = bmp280_measure_time_max_us(forced);
+
+        ktime_t start = ktime_get();
+        ret = regmap_write(data->regmap, BMP280_REG_CTRL_MEAS, forced);
+        if(ret < 0)
+            goto restore;
+
+        usleep_range(max_us / 2, max_us / 2 + 100);
+        do {
+            ret = regmap_read(data->regmap, BMP280_REG_STATUS, &status);
+            if(ret < 0)
+                goto restore;
+            if(!(status & BMP280_STATUS_MEASURING))
+                break;
+            usleep_range(50, 100);
+        } while(ktime_us_delta(ktime_get(), start) < 2 * max_us);
+
+        if(status & BMP280_STATUS_MEASURING) {
+            ret = -ETIMEDOUT;
+            goto restore;
+        }
+
+        measured_us[code] = ktime_us_delta(ktime_get(), start);
+        scale = max(scale, DIV_ROUND_UP(measured_us[code] * 1000, max_us));
+    }
+
+    memcpy(data->t_measured_us, measured_us, sizeof(measured_us));
+    WRITE_ONCE(data->t_scale, min(scale, 1000U));
+
+restore:
+    if(regmap_write(data->regmap, BMP280_REG_CTRL_MEAS, ctrl_meas) < 0 && ret == 0)
+        ret = -EIO;
+    bmp280_period_refresh(data);
+out:
+    mutex_unlock(&data->lock);
+    mutex_unlock(&data->acq_lock);
+    return ret;
+}
+
+/*
+ * Decides whether the next forced conversion measures temperature, called under the
+ * core lock. It does every temp_interval-th time, once the cached t_fine is older than
+ * temp_max_age_us, and whenever there is nothing cached yet.
+ */
+static bool bmp280_temp_due(struct bmp280_data *data)
+{
+    unsigned int interval = READ_ONCE(data->temp_interval);
+    unsigned int max_age_us = READ_ONCE(data->temp_max_age_us);
+
+    spin_lock(&data->read_lock);
+    ktime_t stamp = data->t_fine_stamp;
+    spin_unlock(&data->read_lock);
+
+    bool due = interval <= 1 || !stamp || ++data->temp_cycles >= interval ||
+               (max_age_us && ktime_us_delta(ktime_get(), stamp) >= max_age_us);
+    if(due)
+        data->temp_cycles = 0;
+
+    return due;
+}
+
+/*
+ * Purpose:
+ *   Starts one forced conversion, measuring temperature only when it is due.
+ *
+ * Parameters:
+ *   @data:      Pointer to the BMP280 driver data, its lock must be held.
+ *   @ctrl_meas: ctrl_meas to convert with, mode = 01.
+ *   @temp:      Output, whether the conversion measures temperature.
+ *
+ * Return:
+ *   Conversion time in microseconds, or a negative error code if the write failed.
+ *
+ * Details:
+ *   Skipping temperature (osrs_t = 000) saves 2.3 ms per temperature oversample, so
+ *   pressure can be sampled faster. The skipping write goes out with
+ *   regmap_multi_reg_write_bypassed(), which bypasses the cache for that one write
+ *   under the regmap lock, so other accesses keep using the cache meanwhile. The
+ *   configured osrs_t stays in the cache and comes back with the next conversion that
+ *   measures temperature. Its result must be read with bmp280_read_press().
+ */
+int bmp280_start_forced(struct bmp280_data *data, u8 ctrl_meas, bool *temp)
+{
+    int ret;
+
+    *temp = bmp280_temp_due(data);
+    if(*temp) {
+        ret = regmap_write(data->regmap, BMP280_REG_CTRL_MEAS, ctrl_meas);
+    } else {
+        const struct reg_sequence skip = { BMP280_REG_CTRL_MEAS, ctrl_meas & ~BMP280_OSRS_T_MASK };
+
+        ctrl_meas = skip.def;
+        ret = regmap_multi_reg_write_bypassed(data->regmap, &skip, 1);
+    }
+
+    return ret < 0 ? ret : bmp280_measure_time_us(data, ctrl_meas);
+}
+
+/*
+ * Purpose:
+ *   Runs one forced conversion and reads its result.
+ *
+ * Parameters:
+ *   @data: Pointer to the BMP280 driver data.
+ *   @osrs: osrs_t and osrs_p bits of ctrl_meas to convert with, 0 for the active ones.
+ *   @raw:  Output buffer laid out like the 0xF7-0xFC block, see bmp280_read_raw().
+ *
+ * Return:
+ *   0 on success, negative error code if sensor communication fails.
+ *
+ * Details:
+ *   ctrl_meas is written with the oversampling and mode = 01, then the reader sleeps for
+ *   exactly the conversion time of that setting before reading the data block in one
+ *   burst, so the result is always a fresh conversion and the latency is deterministic.
+ *   The sensor drops back to sleep by itself afterwards. A one-off oversampling or a
+ *   conversion squeezed into normal mode is undone again, restarting normal mode if the
+ *   sensor was in it. Conversions with the active oversampling may skip temperature,
+ *   see bmp280_start_forced(), one-off presets always measure it. The core lock keeps
+ *   reconfiguration from restarting the conversion halfway.
+ */
+int bmp280_read_forced(struct bmp280_data *data, u8 osrs, u8 raw[BMP280_DATA_LEN])
+{
+    const u8 osrs_mask = BMP280_OSRS_T_MASK | BMP280_OSRS_P_MASK;
+    unsigned int ctrl_meas;
+
+    mutex_lock(&data->lock);
+
+    int ret = regmap_read(data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas);
+    if(ret < 0)
+        goto out;
+    if(!osrs)
+        osrs = ctrl_meas & osrs_mask;
+
+    u8 forced = (ctrl_meas & ~(osrs_mask | BMP280_MODE_MASK)) | osrs | BMP280_MODE_FORCED;
+    bool temp = true;
+    if((ctrl_meas & osrs_mask) == osrs && (ctrl_meas & BMP280_MODE_MASK) != BMP280_MODE_NORMAL)
+        ret = bmp280_start_forced(data, forced, &temp);
+    else if((ret = regmap_write(data->regmap, BMP280_REG_CTRL_MEAS, forced)) == 0)
+        ret = bmp280_measure_time_us(data, forced);
+    if(ret < 0)
+        goto out;
+
+    unsigned int wait_us = ret;
+    usleep_range(wait_us, wait_us + wait_us / 16);
+
+    // The cached ctrl_meas now holds osrs, so the read window matches the conversion
+    ret = temp ? bmp280_read_raw(data, true, raw) : bmp280_read_press(data, raw);
+
+    if((ctrl_meas & osrs_mask) != osrs || (ctrl_meas & BMP280_MODE_MASK) == BMP280_MODE_NORMAL) {
+        if((ctrl_meas & BMP280_MODE_MASK) == BMP280_MODE_FORCED)
+            ctrl_meas = (ctrl_meas & ~BMP280_MODE_MASK) | BMP280_MODE_SLEEP;
+        if(regmap_write(data->regmap, BMP280_REG_CTRL_MEAS, ctrl_meas) < 0 && ret == 0)
+            ret = -EIO;
+    }
+
+out:
+    mutex_unlock(&data->lock);
+    return ret;
+}
+
+/*
+ * Purpose:
+ *   Gets a compensated sample for a reader.
+ *
+ * Parameters:
+ *   @data:   Pointer to the BMP280 driver data.
+ *   @sample: Output, the sample.
+ *
+ * Return:
+ *   0 on success, negative error code if sensor communication fails.
+ *
+ * Details:
+ *   Serves the latest published sample while the acquisition worker keeps it fresh or
+ *   it is within the cache TTL. Otherwise the first reader reads the data block in one
+ *   go, so both channels come from the same conversion, and publishes it. In forced
+ *   mode it starts a conversion of its own first. Readers that arrive while that fetch
+ *   is in flight do not touch the bus, they wait for it and share its result, so
+ *   concurrent readers cost a single transfer.
+ */
+static int bmp280_get_sample(struct bmp280_data *data, struct bmp280_sample *sample)
+{
+    int ret;
+
+    if(bmp280_fresh(data, sample))
+        return 0;
+
+    spin_lock(&data->read_lock);
+    if(data->read_busy) {
+        data->coalesced++;
+        spin_unlock(&data->read_lock);
+
+        wait_for_completion(&data->read_done);
+
+        spin_lock(&data->read_lock);
+        ret = data->read_ret;
+        spin_unlock(&data->read_lock);
+
+        if(ret == 0 && !bmp280_latest(data, sample))
+            ret = -EIO;
+        return ret;
+    }
+    data->read_busy = true;
+    reinit_completion(&data->read_done);
+    spin_unlock(&data->read_lock);
+
+    if(READ_ONCE(data->on_demand))
+        ret = bmp280_read_forced(data, 0, sample->raw);
+    else
+        ret = bmp280_read_raw(data, true, sample->raw);
+    if(ret < 0) {
+        dev_err(data->dev, "Failed to read from raw Pressure and Temperature data registers\n");
+    } else {
+        sample->timestamp = ktime_get();
+        ret = bmp280_compensate_sample(data, sample);
+        if(ret == 0)
+            bmp280_publish(data, sample);
+    }
+
+    spin_lock(&data->read_lock);
+    data->read_ret = ret;
+    data->read_busy = false;
+    spin_unlock(&data->read_lock);
+    complete_all(&data->read_done);
+
+    return ret;
+}
+
+/*
+ * Oversampling presets for deadline reads, best resolution first. These are the
+ * datasheet's recommended settings (table 7), from ultra high resolution (x2/x16) down
+ * to ultra low power (x1/x1).
+ */
+static const u8 bmp280_deadline_presets[] = {
+    (2 << BMP280_OSRS_T_SHIFT) | (5 << BMP280_OSRS_P_SHIFT),
+    (1 << BMP280_OSRS_T_SHIFT) | (4 << BMP280_OSRS_P_SHIFT),
+    (1 << BMP280_OSRS_T_SHIFT) | (3 << BMP280_OSRS_P_SHIFT),
+    (1 << BMP280_OSRS_T_SHIFT) | (2 << BMP280_OSRS_P_SHIFT),
+    (1 << BMP280_OSRS_T_SHIFT) | (1 << BMP280_OSRS_P_SHIFT),
+};
+
+/*
+ * Purpose:
+ *   Gets a sample for a consumer with a staleness limit and a latency budget.
+ *
+ * Parameters:
+ *   @data:             Pointer to the BMP280 driver data.
+ *   @max_staleness_us: Oldest acceptable age of the latest sample, 0 always converts.
+ *   @deadline_us:      Time a fresh conversion may take.
+ *   @sample:           Output, the compensated sample.
+ *   @osrs:             Output, osrs_t and osrs_p bits of a fresh conversion, 0 if the
+ *                      latest sample was returned.
+ *
+ * Return:
+ *   0 on success, -ETIME if no preset fits the deadline, -EBUSY if a conversion is
+ *   needed while acquisition runs, other negative error codes if sensor communication
+ *   fails.
+ *
+ * Details:
+ *   A fresh conversion uses the first preset whose conversion time, including the
+ *   usleep_range() slack of bmp280_read_forced(), fits the deadline. The conversion time
+ *   is the measured one when bmp280_measure_timing() ran and the datasheet maximum
+ *   otherwise. Acquisition owns the sensor's mode while it runs, so forced conversions
+ *   are refused then. The result is published like any other sample.
+ */
+int bmp280_read_deadline(struct bmp280_data *data, unsigned int max_staleness_us, unsigned int deadline_us,
+                         struct bmp280_sample *sample, u8 *osrs)
+{
+    *osrs = 0;
+    if(max_staleness_us && bmp280_latest(data, sample) &&
+       ktime_us_delta(ktime_get(), sample->timestamp) <= max_staleness_us)
+        return 0;
+
+    if(READ_ONCE(data->acq_mode) != BMP280_ACQ_OFF)
+        return -EBUSY;
+
+    for(size_t i = 0; i < ARRAY_SIZE(bmp280_deadline_presets); i++) {
+        unsigned int us = bmp280_measure_time_us(data, bmp280_deadline_presets[i]);
+
+        if(us + us / 16 <= deadline_us) {
+            *osrs = bmp280_deadline_presets[i];
+            break;
+        }
+    }
+    if(!*osrs)
+        return -ETIME;
+
+    int ret = bmp280_read_forced(data, *osrs, sample->raw);
+    if(ret < 0)
+        return ret;
+
+    sample->timestamp = ktime_get();
+    ret = bmp280_compensate_sample(data, sample);
+    if(ret < 0)
+        return ret;
+    bmp280_publish(data, sample);
+
+    return 0;
+}
+
+/*
+ * Purpose:
+ *   Sysfs show function for the BMP280 driver.
+ *   When userspace reads the sysfs attribute, this function fetches and formats
+ *   the latest temperature and pressure readings from the sensor, applies compensation
+ *   algorithms, and writes the formatted string to the provided buffer.
+ *
+ * Parameters:
+ *   @dev:  Pointer to the device structure representing the BMP280 sensor.
+ *   @attr: Pointer to the device attribute structure (not used here).
+ *   @buf:  Output buffer where the result string is written.
+ *
+ * Return:
+ *   On success: Number of bytes written to the buffer (as per sysfs show convention).
+ *   On failure: Negative error code (e.g., -EIO) if sensor communication fails.
+ *
+ * Details:
+ *   This function is called each time a user reads the sysfs file (e.g.,
+ *   'cat /sys/bus/i2c/devices/1-0076/Bmp280-Calculations').
+ *   While the acquisition worker runs, or the last sample is still within the cache TTL,
+ *   that sample is returned without touching the bus. Otherwise it reads raw temperature and pressure values from the
+ *   sensor, applies Bosch's integer compensation formula, and publishes the result as the
+ *   latest sample. Either way the results are formatted as a human-readable string in buf.
+ */
+static ssize_t pressureAndTemperature_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    printk(KERN_INFO "Measuring and Displaying the calculated temperature and pressure...");
+
+    struct bmp280_data *data = dev_get_drvdata(dev); // Used to reference the I2C api
+
+    struct bmp280_sample sample;
+    int ret = bmp280_get_sample(data, &sample);
+    if(ret < 0)
+        return ret;
+
+    if(!sample.press)
+        return sprintf(buf, "Temperature: %d°C\nPressure: unavailable\n", sample.temp/100);
+    return sprintf(buf, "Temperature: %d°C\nPressure: %uPa\n", sample.temp/100, sample.press/256);
+}
+static struct device_attribute dev_attr_pressureAndTemperature = __ATTR(Bmp280-Calculations, 0444, pressureAndTemperature_show, NULL); //Sysfs object that would be pressure file for the device driver
+
+/*
+ * Sysfs show function for temperature-only reads, e.g.
+ * 'cat /sys/bus/i2c/devices/1-0076/Bmp280-Temperature'. Only the temperature registers
+ * (0xFA onwards) are read, which is half the bus traffic of Bmp280-Calculations, and
+ * none at all while the latest sample is fresh.
+ */
+static ssize_t temperature_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    struct bmp280_sample sample;
+
+    if(bmp280_fresh(data, &sample))
+        return sprintf(buf, "Temperature: %d°C\n", sample.temp/100);
+
+    // Forced mode needs a conversion anyway, which always measures pressure too
+    if(READ_ONCE(data->on_demand)) {
+        int ret = bmp280_get_sample(data, &sample);
+        return ret < 0 ? ret : sprintf(buf, "Temperature: %d°C\n", sample.temp/100);
+    }
+
+    if(bmp280_read_raw(data, false, sample.raw) < 0) {
+        dev_err(data->dev, "Failed to read from raw Temperature data registers\n");
+        return -EIO;
+    }
+
+    int ret = bmp280_compensate_sample(data, &sample);
+    if(ret < 0)
+        return ret;
+
+    return sprintf(buf, "Temperature: %d°C\n", sample.temp/100);
+}
+static struct device_attribute dev_attr_temperature = __ATTR(Bmp280-Temperature, 0444, temperature_show, NULL);
+
+/*
+ * Sysfs show function reporting how the transport talks to the sensor, e.g.
+ * 'cat /sys/bus/i2c/devices/1-0076/Bmp280-Transfer' prints "i2c" on the I2C fast path,
+ * SPI devices report "spi-4wire" or "spi-3wire".
+ */
+static ssize_t transfer_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return sprintf(buf, "%s\n", data->transfer);
+}
+static struct device_attribute dev_attr_transfer = __ATTR(Bmp280-Transfer, 0444, transfer_show, NULL);
+
+static ssize_t bmp280_field_show(struct device *dev, char *buf, unsigned int reg, u8 mask, u8 shift,
+                                 const unsigned int *table, size_t n)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    unsigned int value;
+
+    int ret = regmap_read(data->regmap, reg, &value); // Served from the regmap cache
+    if(ret < 0)
+        return ret;
+
+    unsigned int code = (value & mask) >> shift;
+    if(code >= n)
+        code = n - 1; // Codes past the end of the table alias the last entry on the BMP280
+
+    return sprintf(buf, "%u\n", table[code]);
+}
+
+static ssize_t bmp280_field_store(struct device *dev, const char *buf, size_t count, unsigned int reg,
+                                  u8 mask, u8 shift, const unsigned int *table, size_t n)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    unsigned int value;
+
+    int ret = kstrtouint(buf, 0, &value);
+    if(ret < 0)
+        return ret;
+
+    for(size_t code = 0; code < n; code++) {
+        if(table[code] != value)
+            continue;
+
+        ret = bmp280_update_field(data, reg, mask, code << shift);
+        return ret < 0 ? ret : count;
+    }
+
+    return -EINVAL;
+}
+
+static ssize_t temperature_oversampling_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_field_show(dev, buf, BMP280_REG_CTRL_MEAS, BMP280_OSRS_T_MASK, BMP280_OSRS_T_SHIFT,
+                             bmp280_oversampling_ratios, ARRAY_SIZE(bmp280_oversampling_ratios));
+}
+
+static ssize_t temperature_oversampling_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_field_store(dev, buf, count, BMP280_REG_CTRL_MEAS, BMP280_OSRS_T_MASK, BMP280_OSRS_T_SHIFT,
+                              bmp280_oversampling_ratios, ARRAY_SIZE(bmp280_oversampling_ratios));
+}
+static struct device_attribute dev_attr_temperature_oversampling = __ATTR(Bmp280-Temperature-Oversampling, 0644, temperature_oversampling_show, temperature_oversampling_store);
+
+static ssize_t pressure_oversampling_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_field_show(dev, buf, BMP280_REG_CTRL_MEAS, BMP280_OSRS_P_MASK, BMP280_OSRS_P_SHIFT,
+                             bmp280_oversampling_ratios, ARRAY_SIZE(bmp280_oversampling_ratios));
+}
+
+static ssize_t pressure_oversampling_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_field_store(dev, buf, count, BMP280_REG_CTRL_MEAS, BMP280_OSRS_P_MASK, BMP280_OSRS_P_SHIFT,
+                              bmp280_oversampling_ratios, ARRAY_SIZE(bmp280_oversampling_ratios));
+}
+static struct device_attribute dev_attr_pressure_oversampling = __ATTR(Bmp280-Pressure-Oversampling, 0644, pressure_oversampling_show, pressure_oversampling_store);
+
+static ssize_t filter_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_field_show(dev, buf, BMP280_REG_CONFIG, BMP280_FILTER_MASK, BMP280_FILTER_SHIFT,
+                             bmp280_filter_coefficients, ARRAY_SIZE(bmp280_filter_coefficients));
+}
+
+static ssize_t filter_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_field_store(dev, buf, count, BMP280_REG_CONFIG, BMP280_FILTER_MASK, BMP280_FILTER_SHIFT,
+                              bmp280_filter_coefficients, ARRAY_SIZE(bmp280_filter_coefficients));
+}
+static struct device_attribute dev_attr_filter = __ATTR(Bmp280-Filter, 0644, filter_show, filter_store);
+
+static ssize_t standby_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_field_show(dev, buf, BMP280_REG_CONFIG, BMP280_T_SB_MASK, BMP280_T_SB_SHIFT,
+                             bmp280_standby_us, ARRAY_SIZE(bmp280_standby_us));
+}
+
+static ssize_t standby_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_field_store(dev, buf, count, BMP280_REG_CONFIG, BMP280_T_SB_MASK, BMP280_T_SB_SHIFT,
+                              bmp280_standby_us, ARRAY_SIZE(bmp280_standby_us));
+}
+static struct device_attribute dev_attr_standby = __ATTR(Bmp280-Standby-us, 0644, standby_show, standby_store);
+
+/*
+ * Sysfs attribute for the measured conversion times, e.g.
+ * 'echo 1 > /sys/bus/i2c/devices/1-0076/Bmp280-Measure-Time' measures them (acquisition
+ * must be off) and 'echo 0 > ...' goes back to the datasheet maxima. Reading it shows
+ * the measured and datasheet time per symmetric oversampling setting and the scale in
+ * effect.
+ */
+static ssize_t measure_time_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    ssize_t len = 0;
+
+    mutex_lock(&data->lock);
+    for(unsigned int code = BMP280_OSRS_X1; code < ARRAY_SIZE(bmp280_oversampling_ratios); code++) {
+        u8 ctrl_meas = (code << BMP280_OSRS_T_SHIFT) | (code << BMP280_OSRS_P_SHIFT);
+        len += sysfs_emit_at(buf, len, "x%u: %uus (datasheet %uus)\n", bmp280_oversampling_ratios[code],
+                             data->t_measured_us[code], bmp280_measure_time_max_us(ctrl_meas));
+    }
+    len += sysfs_emit_at(buf, len, "Scale: %u/1000\n", data->t_scale ?: 1000);
+    mutex_unlock(&data->lock);
+
+    return len;
+}
+
+static ssize_t measure_time_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    bool measure;
+
+    int ret = kstrtobool(buf, &measure);
+    if(ret < 0)
+        return ret;
+
+    if(measure) {
+        ret = bmp280_measure_timing(data);
+        if(ret < 0)
+            return ret;
+    } else {
+        mutex_lock(&data->lock);
+        memset(data->t_measured_us, 0, sizeof(data->t_measured_us));
+        WRITE_ONCE(data->t_scale, 0);
+        bmp280_period_refresh(data);
+        mutex_unlock(&data->lock);
+    }
+
+    return count;
+}
+static struct device_attribute dev_attr_measure_time = __ATTR(Bmp280-Measure-Time, 0644, measure_time_show, measure_time_store);
+
+/*
+ * Sysfs attribute selecting how readers get their data, e.g.
+ * 'echo forced > /sys/bus/i2c/devices/1-0076/Bmp280-Mode'. "normal" keeps the sensor
+ * converting continuously, "forced" keeps it asleep and every read that cannot be
+ * served from the cache runs a conversion of its own. Background acquisition must be
+ * off to switch to forced mode, it relies on the sensor converting by itself.
+ */
+static ssize_t mode_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%s\n", READ_ONCE(data->on_demand) ? "forced" : "normal");
+}
+
+static ssize_t mode_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    bool on_demand;
+    int ret;
+
+    if(sysfs_streq(buf, "forced"))
+        on_demand = true;
+    else if(sysfs_streq(buf, "normal"))
+        on_demand = false;
+    else
+        return -EINVAL;
+
+    mutex_lock(&data->acq_lock);
+
+    if(data->acq_mode != BMP280_ACQ_OFF) {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    ret = bmp280_update_field(data, BMP280_REG_CTRL_MEAS, BMP280_MODE_MASK,
+                              on_demand ? BMP280_MODE_SLEEP : BMP280_MODE_NORMAL);
+    if(ret == 0)
+        WRITE_ONCE(data->on_demand, on_demand);
+
+out:
+    mutex_unlock(&data->acq_lock);
+    return ret < 0 ? ret : count;
+}
+static struct device_attribute dev_attr_mode = __ATTR(Bmp280-Mode, 0644, mode_show, mode_store);
+
+/*
+ * Sysfs attributes decoupling temperature from pressure in forced conversions (forced
+ * mode and high-rate acquisition), e.g.
+ * 'echo 10 > /sys/bus/i2c/devices/1-0076/Bmp280-Temperature-Interval' measures
+ * temperature in every 10th conversion only and compensates the others with the cached
+ * t_fine. Bmp280-Temperature-Max-Age-us bounds that reuse in time, 0 means no bound. An
+ * interval of 1 measures temperature every time.
+ */
+static ssize_t temperature_interval_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(data->temp_interval));
+}
+
+static ssize_t temperature_interval_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    unsigned int interval;
+
+    int ret = kstrtouint(buf, 0, &interval);
+    if(ret < 0)
+        return ret;
+    if(!interval)
+        return -EINVAL;
+
+    WRITE_ONCE(data->temp_interval, interval);
+    return count;
+}
+static struct device_attribute dev_attr_temperature_interval = __ATTR(Bmp280-Temperature-Interval, 0644, temperature_interval_show, temperature_interval_store);
+
+static ssize_t temperature_max_age_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(data->temp_max_age_us));
+}
+
+static ssize_t temperature_max_age_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    unsigned int max_age_us;
+
+    int ret = kstrtouint(buf, 0, &max_age_us);
+    if(ret < 0)
+        return ret;
+
+    WRITE_ONCE(data->temp_max_age_us, max_age_us);
+    return count;
+}
+static struct device_attribute dev_attr_temperature_max_age = __ATTR(Bmp280-Temperature-Max-Age-us, 0644, temperature_max_age_show, temperature_max_age_store);
+
+static struct attribute *bmp280_attrs[] = {
+    &dev_attr_pressureAndTemperature.attr,
+    &dev_attr_temperature.attr,
+    &dev_attr_transfer.attr,
+    &dev_attr_temperature_oversampling.attr,
+    &dev_attr_pressure_oversampling.attr,
+    &dev_attr_filter.attr,
+    &dev_attr_standby.attr,
+    &dev_attr_measure_time.attr,
+    &dev_attr_mode.attr,
+    &dev_attr_temperature_interval.attr,
+    &dev_attr_temperature_max_age.attr,
+    NULL,
+};
+
+static const struct attribute_group bmp280_attr_group = {
+    .attrs = bmp280_attrs,
+};
+
+static const struct attribute_group *bmp280_attr_groups[] = {
+    &bmp280_attr_group,
+    &bmp280_acq_attr_group,
+    &bmp280_cdev_attr_group,
+    NULL,
+};
+
+/*
+ * Purpose:
+ *   Helper function for the BMP280 driver to fetch the trimming parameters
+ *   (dig_T1..dig_T3, dig_P1..dig_P9) stored in the sensor NVM.
+ *
+ * Parameters:
+ *   @data: Pointer to the driver data whose calibration fields are filled in.
+ *
+ * Return:
+ *   0 on success.
+ *   Negative error code (e.g., -EIO) if the calibration block could not be read.
+ *
+ * Details:
+ *   The twelve parameters live back to back in registers 0x88-0x9F as 16-bit
+ *   little-endian words, so the whole block is pulled in with one burst read and
+ *   decoded afterwards. The fields are only written once the read has succeeded,
+ *   so a failed transfer never leaves garbage coefficients behind.
+ *
+ *   regmap would split a read of a cold cached range into one transfer per register,
+ *   so the block is read with the cache bypassed; the decoded fields below are the
+ *   copy the compensation code works from.
+ */
+static int bmp280_read_calibration(struct bmp280_data *data)
+{
+    __le16 calib[BMP280_CALIB_LEN / 2];
+
+    regcache_cache_bypass(data->regmap, true);
+    int ret = regmap_raw_read(data->regmap, BMP280_CALIB_REG, calib, BMP280_CALIB_LEN);
+    regcache_cache_bypass(data->regmap, false);
+    if(ret < 0)
+        return ret;
+
+    data->dig_T1 = le16_to_cpu(calib[0]);
+    data->dig_T2 = (s16)le16_to_cpu(calib[1]);
+    data->dig_T3 = (s16)le16_to_cpu(calib[2]);
+
+    data->dig_P1 = le16_to_cpu(calib[3]);
+    data->dig_P2 = (s16)le16_to_cpu(calib[4]);
+    data->dig_P3 = (s16)le16_to_cpu(calib[5]);
+    data->dig_P4 = (s16)le16_to_cpu(calib[6]);
+    data->dig_P5 = (s16)le16_to_cpu(calib[7]);
+    data->dig_P6 = (s16)le16_to_cpu(calib[8]);
+    data->dig_P7 = (s16)le16_to_cpu(calib[9]);
+    data->dig_P8 = (s16)le16_to_cpu(calib[10]);
+    data->dig_P9 = (s16)le16_to_cpu(calib[11]);
+
+    return 0;
+}
+
+/*
+ * Purpose:
+ *   Common probe function for the BMP280 driver, called by the I2C and SPI front ends
+ *   once they have a register map for the device. Initializes the sensor, verifies the
+ *   chip ID, resets configuration registers, reads calibration parameters, and creates
+ *   sysfs entries for user access.
+ *
+ * Parameters:
+ *   @dev:      Pointer to the I2C or SPI device representing the BMP280.
+ *              Used for registering sysfs files and device logging.
+ *   @regmap:   Register map set up by the front end, all sensor I/O goes through it.
+ *   @transfer: Short description of the transport, reported in Bmp280-Transfer.
+ *   @spi3w:    True when the sensor is wired for 3-wire SPI and spi3w_en must stay set.
+ *
+ * Return:
+ *   0 on success (driver initialized and ready).
+ *   Negative error code (e.g., -ENODEV, -EIO) on failure to communicate with the sensor,
+ *   invalid chip ID, or any hardware initialization error.
+ *
+ * Details:
+ *   This function is responsible for preparing the BMP280 sensor for operation:
+ *     - Checks the sensor's chip ID to ensure correct device.
+ *     - Resets and configures sensor registers for normal mode.
+ *     - Reads and stores calibration constants from sensor NVM.
+ *     - Creates the character device and registers sysfs attributes to expose sensor
+ *       readings to userspace.
+ *     - Retrieves calibration register values to compensate for reading values.
+ *   In 3-wire SPI mode the sensor only answers reads once spi3w_en is set, and a soft
+ *   reset clears it again, so it is written before the chip ID read and after the reset.
+ */
+int bmp280_common_probe(struct device *dev, struct regmap *regmap, const char *transfer, bool spi3w)
+{
+    int ret;
+
+    struct bmp280_data *data = devm_kzalloc(dev, sizeof(*data), GFP_KERNEL);
+    if(!data)
+        return -ENOMEM;
+    data->dev = dev;
+    data->regmap = regmap;
+    data->transfer = transfer;
+    data->config_flags = spi3w ? BMP280_SPI3W_EN : 0;
+    mutex_init(&data->lock);
+    data->temp_interval = 1;
+    spin_lock_init(&data->read_lock);
+    init_completion(&data->read_done);
+    dev_set_drvdata(dev, data);
+
+    bmp280_acq_init(data);
+
+    if(spi3w) {
+        ret = regmap_write(data->regmap, BMP280_REG_CONFIG, data->config_flags);
+        if(ret < 0) {
+            dev_err(dev, "Failed to enable 3-wire SPI\n");
+            return ret;
+        }
+    }
+
+    unsigned int chip_id;
+    ret = regmap_read(data->regmap, BMP280_REG_CHIP_ID, &chip_id);  // Confirms the sensor chip id is 0x58
+    if(ret < 0) {
+        dev_err(dev, "Failed to read the chip ID\n");
+        return ret;
+    }
+    if (chip_id != 0x58) {
+        dev_err(dev, "Unexpected chip ID: 0x%x\n", chip_id);
+        return -ENODEV;
+    }
+
+    // Resets the sensor old configurations
+    if(regmap_write(data->regmap, BMP280_REG_RESET, 0xB6) < 0) {
+        dev_err(dev, "Failed to reset sensor\n");
+        return -EIO;
+    }
+    usleep_range(2000, 2500); // Datasheet start-up time t_startup is 2 ms
+
+    if(spi3w && regmap_write(data->regmap, BMP280_REG_CONFIG, data->config_flags) < 0) {
+        dev_err(dev, "Failed to re-enable 3-wire SPI after reset\n");
+        return -EIO;
+    }
+
+    /* 
+    *  Status register has two bits:
+    *   • measuring[0] at bit 3 which is set to 1 when conversion is running or 0 when results are transferred to the registers
+    *   • im_update[0] at bit 0 which is set to 1 where its copying images to NVM or 0 when idle
+    *
+    *   We have to make sure the im_update bit is 0 to start communicating or else garbage data will result from it.
+    */
+    unsigned int status;
+    int tries = 10; // Gives enough time for the NVM to perform data copy
+    do {
+
+        ret = regmap_read(data->regmap, BMP280_REG_STATUS, &status);
+        if(ret < 0) {
+            dev_err(dev, "Failed to read the status register\n");
+            return ret;
+        }
+        usleep_range(1000, 1200);
+
+    } while((status & BMP280_STATUS_IM_UPDATE) && --tries > 0);
+
+    // Setting up the measurement register
+
+    /*
+                    *** ACCORDING TO THE REGISTER DATASHEET FOR BMP 280 ***
+    * For a simple bmp 280 device we are dealing with we need to go for the safest route:
+    *   • For mode[1 : 0] we go with normal mode which is 11
+    *   • For osrs_p[2 : 0] which oversamples x4 for pressure we need to go with the standard resolution which is 011
+    *   • For osrs_t[2 : 0] which oversamples x1 for temperature we need to go with the standard resolution which is 001
+    * This leaves us with a byte value of 0b00101111 (a.k.a 0x2F)for the 0xF4 register which is segmented as such:
+    * |-------------------------|-------------------------|-------------------|
+    * |      osrs_t[2 : 0]      |      osrs_p[2 : 0]      |    mode[1 : 0]    |
+    * |-------------------------|-------------------------|-------------------|
+    */
+
+    //Setting up the config register
+
+    /*
+                    *** ACCORDING TO THE REGISTER DATASHEET FOR BMP 280 ***
+    * For spi3w_en[0] we set it to 0 for I2C and 4-wire SPI, bmp280_reconfigure() ORs in config_flags for 3-wire SPI
+    * For filter[2 : 0] we set it to IIR filter coeffecient of 4 which is 010 for low filtering to reduce short-term disturbances
+    * For t_sb[2 : 0]  we set it to 125 ms since the IIR fc is 4 and we are going with the standard resolution method which is bit value of 010
+    *
+    * This leaves us with a byte value of 0b01001000 (a.k.a 0x48) which is segmented as follows:
+    * |-------------------------|-------------------------|----------|-----------|
+    * |       t_sb[2 : 0]       |      filter[2 : 0]      |(reserved)|spi3w_en[0]|
+    * |-------------------------|-------------------------|----------|-----------|
+    *
+    * Both registers go out as one sleep -> config -> ctrl_meas write sequence.
+    */
+    if(bmp280_reconfigure(data, 0x2F, 0x48) < 0) {
+        dev_err(dev, "Failed to configure the ctrl_meas and config registers\n");
+        return -EIO;
+    }
+
+    /* Intialization of calibration registers for temp/pressure calculations */
+    ret = bmp280_read_calibration(data);
+    if(ret < 0) {
+        dev_err(dev, "Failed to read the calibration registers\n");
+        return ret;
+    }
+
+    if(measure_timing) {
+        if(bmp280_measure_timing(data) < 0)
+            dev_warn(dev, "Failed to measure the conversion time, using the datasheet maxima\n");
+        else
+            dev_info(dev, "Conversions take %u/1000 of the datasheet maxima\n", data->t_scale);
+    }
+
+    ret = bmp280_cdev_register(data);
+    if(ret < 0) {
+        dev_err(dev, "Failed to create the character device\n");
+        return ret;
+    }
+
+    if(sysfs_create_groups(&dev->kobj, bmp280_attr_groups) < 0) {
+        dev_err(dev, "Failed to load the sysfs files");
+        bmp280_cdev_unregister(data);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+/*
+ * Purpose:
+ *   Common remove function for the BMP280 driver, called by the I2C and SPI front ends
+ *   when the driver is unloaded or the device is removed. Cleans up driver resources,
+ *   disables the sensor, and removes sysfs entries created during initialization.
+ *
+ * Parameters:
+ *   @dev: Pointer to the I2C or SPI device representing the BMP280.
+ *
+ * Return:
+ *   None. (This function returns void.)
+ *
+ * Details:
+ *   This function is responsible for:
+ *     - Removing any sysfs attributes/files associated with the device.
+ *     - Stopping the acquisition worker.
+ *     - Setting the sensor into sleep mode to reduce power consumption.
+ *     - Removing the character device.
+ */
+void bmp280_common_remove(struct device *dev)
+{
+    printk(KERN_INFO "BMP280: Removed\n");
+
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    sysfs_remove_groups(&dev->kobj, bmp280_attr_groups);
+    bmp280_acq_remove(data);
+
+    // Sets the 0xF4 register to sleep mode, skipped by regmap if it is already asleep
+    regmap_update_bits(data->regmap, BMP280_REG_CTRL_MEAS, BMP280_MODE_MASK, BMP280_MODE_SLEEP);
+
+    bmp280_cdev_unregister(data);
+}
+
+/* Registers both front ends, a sensor can be wired to either bus */
+static int __init bmp280_init(void)
+{
+    int ret = bmp280_i2c_register();
+    if(ret < 0)
+        return ret;
+
+    ret = bmp280_spi_register();
+    if(ret < 0)
+        bmp280_i2c_unregister();
+
+    return ret;
+}
+
+static void __exit bmp280_exit(void)
+{
+    bmp280_spi_unregister();
+    bmp280_i2c_unregister();
+}
+
+module_init(bmp280_init);
+module_exit(bmp280_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Abdelrahman ElShafay");
+MODULE_DESCRIPTION("BMP280 I2C/SPI Driver Module");
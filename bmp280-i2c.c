@@ -0,0 +1,1526 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/i2c.h>       // For I2C support
+#include <linux/list.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/spinlock.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
+#include <linux/list_sort.h>
+
+#include "bmp280.h"
+
+#define BMP280_I2C_DEFAULT_KHZ      100                  // Standard mode, used to estimate bus time
+#define BMP280_I2C_BUDGET_WINDOW_NS (100LL * NSEC_PER_MSEC) // Longest burst the budget lets through at once
+#define BMP280_I2C_DEFAULT_RETRIES  3                    // Retries of a failed access before giving up
+#define BMP280_I2C_DEFAULT_RETRY_US 20000                // Longest a request may spend retrying
+#define BMP280_I2C_BACKOFF_US       250                  // First retry delay, doubled on every retry
+
+/*
+ * Read and write primitives for one way of talking to the sensor over I2C. Writes are
+ * handed register/value pairs (reg0, val0, reg1, val1, ...) which is the only multi-byte
+ * write format the BMP280 understands. They are only ever called from the adapter's
+ * scheduler with the bus already locked, so they use the unlocked I2C/SMBus calls.
+ */
+struct bmp280_xfer {
+    const char *name;
+    int (*read)(struct i2c_client *client, u8 reg, u8 *values, size_t len);
+    int (*write)(struct i2c_client *client, const u8 *pairs, size_t len);
+};
+
+/*
+ * All bmp280 instances sharing one I2C adapter. Every register access of every sensor on
+ * the adapter is queued here and carried out by one worker in batches, and the member
+ * list lets a whole bus be sampled in a single transfer.
+ */
+struct bmp280_i2c_bus {
+    struct i2c_adapter *adapter;
+    bool combined;               // Plain I2C adapter, batches can go out as one combined transfer
+    struct list_head node;       // Entry in bmp280_i2c_buses
+    unsigned int users;          // Probed or probing instances using this adapter
+
+    struct list_head members;    // Fully probed bmp280_i2c instances, sorted by address
+    size_t count;                // Number of entries in members
+    struct mutex lock;           // Protects members and serializes group transfers
+
+    struct list_head pending;    // bmp280_i2c_req waiting for the next batch
+    spinlock_t pending_lock;     // Protects pending and the budget
+    struct delayed_work work;    // Runs the batches on bmp280_i2c_wq, delayed while over budget
+
+    /*
+     * Bus-time budget, a token bucket per limit that refills continuously and holds at
+     * most BMP280_I2C_BUDGET_WINDOW_NS worth of traffic. A limit of 0 disables it.
+     */
+    unsigned int max_tps;        // Transactions per second
+    unsigned int max_share;      // Percent of the bus time, estimated from the bytes moved
+    unsigned int khz;            // Bus clock the bus time estimate is based on
+    bool serve_cached;           // Answer data reads from the last sample instead of delaying them
+    ktime_t budget_stamp;        // Time of the last refill
+    s64 tx_tokens;               // Transactions left, in units of 1/NSEC_PER_SEC transaction
+    s64 ns_tokens;               // Bus time left, in ns
+    unsigned long budget_hits;   // Batches that found the budget exhausted
+    unsigned long delayed;       // Requests delayed by the budget
+    unsigned long cached;        // Reads answered from the last sample by the budget
+
+    unsigned int retries;        // Retries of a failed access, the last one after a bus recovery
+    unsigned int retry_us;       // Latency cap of all retries of one request together
+};
+
+/*
+ * One register access queued on an adapter. Requests live on the stack of the submitter,
+ * who sleeps on done until the worker has carried the access out.
+ */
+struct bmp280_i2c_req {
+    struct list_head node;          // Entry in bus->pending, then in the batch being run
+    struct bmp280_i2c *i2c;         // Target sensor
+    bool write;                     // Register/value pairs in buf, or a read of len registers from reg
+    u8 reg;
+    u8 *buf;
+    size_t len;
+    struct bmp280_i2c_req *leader;  // Identical earlier read in the same batch this one piggybacks on
+    size_t msg;                     // Last message carrying it in a combined transfer
+    int ret;
+    unsigned int attempt;           // Attempts made so far
+    ktime_t deadline;               // No retry is started after this, set by the first attempt
+    ktime_t retry_at;               // When the next attempt is due, 0 unless waiting for one
+    struct completion done;
+};
+
+/* I2C side of a bmp280 instance, handed to regmap as the bus context */
+struct bmp280_i2c {
+    struct i2c_client *client;
+    const struct bmp280_xfer *xfer; // Fastest transfer strategy the adapter supports, picked at probe
+    struct bmp280_data *data;       // Core state, set once bmp280_common_probe() succeeded
+    struct bmp280_i2c_bus *bus;     // Adapter this instance is registered on
+    struct list_head node;          // Entry in bus->members
+    u8 last_raw[BMP280_DATA_LEN];   // Last 0xF7-0xFC contents read, served while over budget
+    u8 last_valid;                  // Bitmask of the bytes of last_raw that have been read
+
+    // Written with the adapter locked only
+    unsigned long errors;           // Accesses that failed even after retrying
+    unsigned long retried;          // Retries of failed accesses
+    unsigned long recoveries;       // Successful bus recoveries triggered by this sensor
+};
+
+static LIST_HEAD(bmp280_i2c_buses);
+static DEFINE_MUTEX(bmp280_i2c_buses_lock); // Protects bmp280_i2c_buses and the users counts
+static struct workqueue_struct *bmp280_i2c_wq;
+
+/*
+ * Plain I2C: register pointer write and data read glued together with a repeated start,
+ * any length in one transaction.
+ */
+static int bmp280_i2c_read(struct i2c_client *client, u8 reg, u8 *values, size_t len)
+{
+    struct i2c_msg msgs[2] = {
+        { .addr = client->addr, .flags = 0, .len = 1, .buf = &reg },
+        { .addr = client->addr, .flags = I2C_M_RD, .len = len, .buf = values },
+    };
+
+    int ret = __i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
+    if(ret < 0)
+        return ret;
+    return ret == ARRAY_SIZE(msgs) ? 0 : -EIO;
+}
+
+static int bmp280_i2c_write(struct i2c_client *client, const u8 *pairs, size_t len)
+{
+    struct i2c_msg msg = { .addr = client->addr, .flags = 0, .len = len, .buf = (u8 *)pairs };
+
+    int ret = __i2c_transfer(client->adapter, &msg, 1);
+    if(ret < 0)
+        return ret;
+    return ret == 1 ? 0 : -EIO;
+}
+
+/*
+ * SMBus I2C-block: up to 32 bytes per transaction. On the wire a block write of
+ * (reg0, val0, reg1, val1, ...) is identical to a plain I2C write of the same pairs.
+ */
+static int bmp280_smbus_block_read(struct i2c_client *client, u8 reg, u8 *values, size_t len)
+{
+    union i2c_smbus_data smbus;
+
+    while(len) {
+        u8 chunk = min_t(size_t, len, I2C_SMBUS_BLOCK_MAX);
+
+        smbus.block[0] = chunk;
+        int ret = __i2c_smbus_xfer(client->adapter, client->addr, client->flags, I2C_SMBUS_READ, reg,
+                                   I2C_SMBUS_I2C_BLOCK_DATA, &smbus);
+        if(ret < 0)
+            return ret;
+        if(smbus.block[0] != chunk)
+            return -EIO;
+        memcpy(values, &smbus.block[1], chunk);
+
+        reg += chunk;
+        values += chunk;
+        len -= chunk;
+    }
+
+    return 0;
+}
+
+static int bmp280_smbus_block_write(struct i2c_client *client, const u8 *pairs, size_t len)
+{
+    union i2c_smbus_data smbus;
+
+    if(len < 2 || len - 1 > I2C_SMBUS_BLOCK_MAX)
+        return -EINVAL;
+
+    smbus.block[0] = len - 1;
+    memcpy(&smbus.block[1], pairs + 1, len - 1);
+    return __i2c_smbus_xfer(client->adapter, client->addr, client->flags, I2C_SMBUS_WRITE, pairs[0],
+                            I2C_SMBUS_I2C_BLOCK_DATA, &smbus);
+}
+
+/* SMBus byte data: one transaction per register, the slowest but most widely supported */
+static int bmp280_smbus_byte_read(struct i2c_client *client, u8 reg, u8 *values, size_t len)
+{
+    union i2c_smbus_data smbus;
+
+    for(size_t i = 0; i < len; i++) {
+        int ret = __i2c_smbus_xfer(client->adapter, client->addr, client->flags, I2C_SMBUS_READ, reg + i,
+                                   I2C_SMBUS_BYTE_DATA, &smbus);
+        if(ret < 0)
+            return ret;
+        values[i] = smbus.byte;
+    }
+
+    return 0;
+}
+
+static int bmp280_smbus_byte_write(struct i2c_client *client, const u8 *pairs, size_t len)
+{
+    union i2c_smbus_data smbus;
+
+    for(size_t i = 0; i + 1 < len; i += 2) {
+        smbus.byte = pairs[i + 1];
+        int ret = __i2c_smbus_xfer(client->adapter, client->addr, client->flags, I2C_SMBUS_WRITE, pairs[i],
+                                   I2C_SMBUS_BYTE_DATA, &smbus);
+        if(ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+/* Ordered fastest first, bmp280_select_xfer() picks the first one the adapter supports */
+static const struct {
+    u32 funcs;
+    struct bmp280_xfer xfer;
+} bmp280_xfers[] = {
+    { I2C_FUNC_I2C,
+      { "i2c", bmp280_i2c_read, bmp280_i2c_write } },
+    { I2C_FUNC_SMBUS_I2C_BLOCK,
+      { "smbus-i2c-block", bmp280_smbus_block_read, bmp280_smbus_block_write } },
+    { I2C_FUNC_SMBUS_BYTE_DATA,
+      { "smbus-byte", bmp280_smbus_byte_read, bmp280_smbus_byte_write } },
+};
+
+/*
+ * Purpose:
+ *   Picks the fastest transfer strategy the I2C adapter of the sensor supports.
+ *
+ * Parameters:
+ *   @adapter: The I2C adapter the BMP280 sits on.
+ *
+ * Return:
+ *   Pointer to the chosen strategy, or NULL if the adapter supports none of them.
+ *
+ * Details:
+ *   Queried once at probe so the hot path never has to check adapter functionality
+ *   again. Raw I2C is preferred since it reads any length in one combined transaction,
+ *   then SMBus I2C-block (32 bytes per transaction), then SMBus byte access.
+ */
+static const struct bmp280_xfer *bmp280_select_xfer(struct i2c_adapter *adapter)
+{
+    for(size_t i = 0; i < ARRAY_SIZE(bmp280_xfers); i++) {
+        if(i2c_check_functionality(adapter, bmp280_xfers[i].funcs))
+            return &bmp280_xfers[i].xfer;
+    }
+
+    return NULL;
+}
+
+/* Sorts a batch by sensor address. list_sort() is stable, so each sensor keeps its request order. */
+static int bmp280_i2c_req_cmp(void *priv, const struct list_head *a, const struct list_head *b)
+{
+    const struct bmp280_i2c_req *ra = list_entry(a, struct bmp280_i2c_req, node);
+    const struct bmp280_i2c_req *rb = list_entry(b, struct bmp280_i2c_req, node);
+
+    return ra->i2c->client->addr - rb->i2c->client->addr;
+}
+
+/*
+ * Marks reads that are identical to an earlier read of the same sensor in the batch, with
+ * no write to that sensor in between. Only the first of them goes on the bus, the others
+ * get a copy of its result.
+ */
+static void bmp280_i2c_merge_reads(struct list_head *batch)
+{
+    struct bmp280_i2c_req *req, *prev;
+
+    list_for_each_entry(req, batch, node) {
+        req->leader = NULL;
+        if(req->write)
+            continue;
+
+        prev = req;
+        list_for_each_entry_continue_reverse(prev, batch, node) {
+            if(prev->i2c != req->i2c || prev->write)
+                break;
+            if(!prev->leader && prev->reg == req->reg && prev->len == req->len) {
+                req->leader = prev;
+                break;
+            }
+        }
+    }
+}
+
+/* Estimated bus time of one request in ns, including start/stop and the address bytes */
+static u64 bmp280_i2c_req_ns(const struct bmp280_i2c_bus *bus, const struct bmp280_i2c_req *req)
+{
+    // Start + address + register + repeated start + address + data + stop, 9 bits per byte
+    unsigned int bits = req->write ? 2 + 9 * (1 + req->len) : 3 + 9 * (3 + req->len);
+
+    return div64_u64((u64)bits * NSEC_PER_SEC, bus->khz * 1000ULL);
+}
+
+/* Refills both token buckets for the time passed since the last refill, pending_lock held */
+static void bmp280_i2c_budget_refill(struct bmp280_i2c_bus *bus)
+{
+    ktime_t now = ktime_get();
+    s64 elapsed = min_t(s64, ktime_to_ns(ktime_sub(now, bus->budget_stamp)), BMP280_I2C_BUDGET_WINDOW_NS);
+
+    bus->budget_stamp = now;
+
+    if(bus->max_tps) {
+        s64 cap = max_t(s64, (s64)bus->max_tps * BMP280_I2C_BUDGET_WINDOW_NS, NSEC_PER_SEC);
+        bus->tx_tokens = min(bus->tx_tokens + elapsed * bus->max_tps, cap);
+    }
+    if(bus->max_share) {
+        s64 cap = BMP280_I2C_BUDGET_WINDOW_NS * bus->max_share / 100;
+        bus->ns_tokens = min(bus->ns_tokens + elapsed * bus->max_share / 100, cap);
+    }
+}
+
+/* Fills both token buckets, used whenever the budget settings change, pending_lock held */
+static void bmp280_i2c_budget_reset(struct bmp280_i2c_bus *bus)
+{
+    bus->budget_stamp = ktime_get();
+    bus->tx_tokens = max_t(s64, (s64)bus->max_tps * BMP280_I2C_BUDGET_WINDOW_NS, NSEC_PER_SEC);
+    bus->ns_tokens = BMP280_I2C_BUDGET_WINDOW_NS * bus->max_share / 100;
+}
+
+/*
+ * Purpose:
+ *   Charges a batch against the adapter's budget.
+ *
+ * Parameters:
+ *   @bus:   The adapter.
+ *   @batch: The sorted, merged batch about to be run.
+ *
+ * Return:
+ *   0 if the batch may go out now, otherwise the time in ns until the budget allows it.
+ *
+ * Details:
+ *   A batch goes out as long as both buckets still hold any tokens and is then charged
+ *   in full, so a batch larger than the bucket drives it into debt instead of being held
+ *   back forever. Merged reads cost nothing since they never reach the bus.
+ */
+static u64 bmp280_i2c_budget_charge(struct bmp280_i2c_bus *bus, struct list_head *batch)
+{
+    struct bmp280_i2c_req *req;
+    u64 wait_ns = 0;
+
+    spin_lock(&bus->pending_lock);
+
+    bmp280_i2c_budget_refill(bus);
+
+    if(bus->max_tps && bus->tx_tokens <= 0)
+        wait_ns = max_t(u64, wait_ns, div64_u64(-bus->tx_tokens, bus->max_tps) + 1);
+    if(bus->max_share && bus->ns_tokens <= 0)
+        wait_ns = max_t(u64, wait_ns, div64_u64(-bus->ns_tokens * 100, bus->max_share) + 1);
+
+    if(wait_ns) {
+        bus->budget_hits++;
+    } else {
+        list_for_each_entry(req, batch, node) {
+            if(req->leader)
+                continue;
+            if(bus->max_tps)
+                bus->tx_tokens -= NSEC_PER_SEC;
+            if(bus->max_share)
+                bus->ns_tokens -= bmp280_i2c_req_ns(bus, req);
+        }
+    }
+
+    spin_unlock(&bus->pending_lock);
+    return wait_ns;
+}
+
+/* Whether a read only covers data register bytes that are in the sensor's last sample */
+static bool bmp280_i2c_req_cached(const struct bmp280_i2c_req *req)
+{
+    if(req->write || req->reg < BMP280_DATA_REG || req->reg + req->len > BMP280_DATA_REG + BMP280_DATA_LEN)
+        return false;
+
+    u8 want = GENMASK(req->len - 1, 0) << (req->reg - BMP280_DATA_REG);
+    return (req->i2c->last_valid & want) == want;
+}
+
+/* Keeps the last data register contents of every sensor for bmp280_i2c_req_cached() */
+static void bmp280_i2c_req_store(struct bmp280_i2c_req *req)
+{
+    if(req->write || req->ret || req->reg < BMP280_DATA_REG || req->reg + req->len > BMP280_DATA_REG + BMP280_DATA_LEN)
+        return;
+
+    memcpy(req->i2c->last_raw + (req->reg - BMP280_DATA_REG), req->buf, req->len);
+    req->i2c->last_valid |= GENMASK(req->len - 1, 0) << (req->reg - BMP280_DATA_REG);
+}
+
+/*
+ * Purpose:
+ *   Holds a batch back while the adapter is over its budget.
+ *
+ * Parameters:
+ *   @bus:     The adapter.
+ *   @batch:   The batch that did not fit the budget.
+ *   @wait_ns: Time until the budget allows traffic again.
+ *
+ * Details:
+ *   With the cache policy, data reads that the last sample of their sensor can answer
+ *   complete right away with that sample. Everything else goes back to the front of the
+ *   pending list, in order, and the worker is rescheduled for when the budget has refilled.
+ */
+static void bmp280_i2c_budget_defer(struct bmp280_i2c_bus *bus, struct list_head *batch, u64 wait_ns)
+{
+    struct bmp280_i2c_req *req, *tmp;
+    unsigned long cached = 0, delayed = 0;
+
+    list_for_each_entry_safe(req, tmp, batch, node) {
+        if(!bus->serve_cached || !bmp280_i2c_req_cached(req)) {
+            delayed++;
+            continue;
+        }
+
+        memcpy(req->buf, req->i2c->last_raw + (req->reg - BMP280_DATA_REG), req->len);
+        req->ret = 0;
+        list_del(&req->node);
+        complete(&req->done);
+        cached++;
+    }
+
+    spin_lock(&bus->pending_lock);
+    list_splice(batch, &bus->pending);
+    bus->cached += cached;
+    bus->delayed += delayed;
+    spin_unlock(&bus->pending_lock);
+
+    if(delayed)
+        mod_delayed_work(bmp280_i2c_wq, &bus->work, nsecs_to_jiffies(wait_ns) + 1);
+}
+
+/*
+ * Purpose:
+ *   Carries out a sorted, merged batch as one combined I2C transfer.
+ *
+ * Parameters:
+ *   @bus:   The adapter, its bus lock must be held.
+ *   @batch: The requests to run.
+ *
+ * Details:
+ *   Reads become a register pointer write plus a data read, back to back writes to the
+ *   same sensor are concatenated into one message of register/value pairs, and the whole
+ *   array goes out in one __i2c_transfer() with repeated starts in between. Requests
+ *   coming back for a retry are left out, they are always retried on their own.
+ *
+ *   Every request that is not a leader ends up with its ret set: 0 once all of its
+ *   messages went out, -EINPROGRESS if nothing of it was sent, or the error its attempt
+ *   ended with, which bmp280_i2c_req_run() counts as the first attempt. When the
+ *   adapter refuses the array up front (-EOPNOTSUPP from its quirks) nothing was sent
+ *   at all. A short transfer reports how many messages made it, so the requests it
+ *   covered are done, the one with the first failed message carries -EIO and the rest
+ *   were never sent. Any other error does not say how far the transfer got, every
+ *   request not known to be done carries it.
+ */
+static void bmp280_i2c_run_combined(struct bmp280_i2c_bus *bus, struct list_head *batch)
+{
+    struct bmp280_i2c_req *req;
+    size_t nmsgs = 0, npairs = 0;
+    int ret;
+
+    list_for_each_entry(req, batch, node) {
+        if(req->leader || req->attempt)
+            continue;
+        nmsgs += req->write ? 1 : 2;
+        npairs += req->write ? req->len : 0;
+    }
+    if(!nmsgs)
+        return;
+
+    struct i2c_msg *msgs = kcalloc(nmsgs, sizeof(*msgs), GFP_KERNEL);
+    u8 *pairs = kmalloc(max_t(size_t, npairs, 1), GFP_KERNEL);
+    if(!msgs || !pairs)
+        goto out;
+
+    struct i2c_msg *last_write = NULL;
+    u8 *next = pairs;
+    nmsgs = 0;
+
+    list_for_each_entry(req, batch, node) {
+        u16 addr = req->i2c->client->addr;
+
+        if(req->leader || req->attempt)
+            continue;
+
+        if(req->write) {
+            memcpy(next, req->buf, req->len);
+            if(last_write && last_write->addr == addr && last_write == &msgs[nmsgs - 1]) {
+                last_write->len += req->len; // Same sensor, pairs follow the previous ones
+            } else {
+                msgs[nmsgs] = (struct i2c_msg){ .addr = addr, .flags = 0, .len = req->len, .buf = next };
+                last_write = &msgs[nmsgs++];
+            }
+            next += req->len;
+        } else {
+            msgs[nmsgs++] = (struct i2c_msg){ .addr = addr, .flags = 0, .len = 1, .buf = &req->reg };
+            msgs[nmsgs++] = (struct i2c_msg){ .addr = addr, .flags = I2C_M_RD, .len = req->len, .buf = req->buf };
+        }
+        req->msg = nmsgs - 1;
+    }
+
+    ret = __i2c_transfer(bus->adapter, msgs, nmsgs);
+    if(ret == -EOPNOTSUPP)
+        goto out;
+
+    list_for_each_entry(req, batch, node) {
+        if(req->leader || req->attempt)
+            continue;
+
+        size_t first = req->write ? req->msg : req->msg - 1;
+        if(ret < 0)
+            req->ret = ret;
+        else if(req->msg < ret)
+            req->ret = 0;
+        else if(first <= ret)
+            req->ret = -EIO;
+    }
+
+out:
+    kfree(msgs);
+    kfree(pairs);
+}
+
+/*
+ * Errors a noisy or glitching bus can produce, worth another attempt. A NACK (-ENXIO on
+ * the address, -EREMOTEIO on data) means the device is absent or refused the transfer,
+ * which no retry or bus recovery changes.
+ */
+static bool bmp280_i2c_transient(int ret)
+{
+    return ret == -EIO || ret == -ETIMEDOUT || ret == -EAGAIN;
+}
+
+/* One attempt at a request on its own, with the adapter's transfer strategy */
+static int bmp280_i2c_req_xfer(struct bmp280_i2c_req *req)
+{
+    struct bmp280_i2c *i2c = req->i2c;
+
+    if(req->write)
+        return i2c->xfer->write(i2c->client, req->buf, req->len);
+    return i2c->xfer->read(i2c->client, req->reg, req->buf, req->len);
+}
+
+/*
+ * Purpose:
+ *   Makes one attempt at a single request and decides whether it gets another.
+ *
+ * Parameters:
+ *   @bus:      The adapter, its bus lock must be held.
+ *   @req:      The request, ret holding the outcome of an attempt already made as part
+ *              of a combined transfer, -EINPROGRESS if there was none.
+ *   @retries:  Retries allowed after the first attempt.
+ *   @retry_us: Time after the first attempt after which no further retry is started.
+ *
+ * Return:
+ *   0 on success, otherwise the error of this attempt. retry_at is set if the request
+ *   is to be retried later, the error is final if it is not.
+ *
+ * Details:
+ *   Retries back off exponentially starting at BMP280_I2C_BACKOFF_US, but are never
+ *   scheduled past the deadline, so a request spends at most bus->retry_us retrying.
+ *   The backoff is not slept here: the caller releases the adapter and comes back once
+ *   retry_at has passed (the worker's delayed work rounds it up to a jiffy), so other
+ *   devices on the adapter are not locked out while a sensor recovers. The last retry
+ *   is preceded by i2c_recover_bus(), which clocks out a slave stuck holding SDA low on
+ *   adapters that support bus recovery. NACKs are never retried, so probing an address
+ *   without a bmp280 still fails right away, while a glitch during probe gets retried
+ *   like at any other time.
+ */
+static int bmp280_i2c_req_run(struct bmp280_i2c_bus *bus, struct bmp280_i2c_req *req, unsigned int retries,
+                              unsigned int retry_us)
+{
+    struct bmp280_i2c *i2c = req->i2c;
+    int ret;
+
+    req->retry_at = 0;
+    if(req->attempt == 0) {
+        req->deadline = ktime_add_us(ktime_get(), retry_us);
+        ret = req->ret == -EINPROGRESS ? bmp280_i2c_req_xfer(req) : req->ret;
+    } else {
+        if(req->attempt == retries && i2c_recover_bus(bus->adapter) == 0)
+            i2c->recoveries++;
+        i2c->retried++;
+        ret = bmp280_i2c_req_xfer(req);
+    }
+    req->attempt++;
+
+    if(ret && bmp280_i2c_transient(ret) && req->attempt <= retries) {
+        ktime_t now = ktime_get();
+        s64 left_us = ktime_us_delta(req->deadline, now);
+
+        if(left_us > 0) {
+            unsigned int backoff_us = BMP280_I2C_BACKOFF_US << min(req->attempt - 1, 12U);
+
+            req->retry_at = ktime_add_us(now, min_t(s64, backoff_us, left_us));
+            return ret;
+        }
+    }
+
+    if(ret) {
+        i2c->errors++;
+        dev_err(&i2c->client->dev, "I2C %s of 0x%02x failed: %d\n", req->write ? "write" : "read",
+                req->write ? req->buf[0] : req->reg, ret);
+    }
+    return ret;
+}
+
+/*
+ * Purpose:
+ *   Runs one batch of queued requests with the adapter locked once.
+ *
+ * Parameters:
+ *   @bus:   The adapter.
+ *   @batch: Requests taken off bus->pending, sorted and merged.
+ *
+ * Details:
+ *   On plain I2C adapters the batch goes out as one combined transfer. If that is not
+ *   possible (SMBus-only adapter, adapter quirks), each request is carried out on its
+ *   own, still under the same bus lock. If it fails partway, the requests
+ *   bmp280_i2c_run_combined() left unfinished go the same way, their failed combined
+ *   attempt counting as the first one, so a failure is reported only to the request
+ *   that caused it. Requests that failed transiently come out with retry_at set and
+ *   are the caller's to run again, see bmp280_i2c_req_run(). Results are stored for the
+ *   budget cache before the bus is unlocked, the bus lock is what serializes the worker
+ *   with real-time submitters running their batch directly.
+ */
+static void bmp280_i2c_run_batch(struct bmp280_i2c_bus *bus, struct list_head *batch)
+{
+    struct bmp280_i2c_req *req;
+
+    spin_lock(&bus->pending_lock);
+    unsigned int retries = bus->retries;
+    unsigned int retry_us = bus->retry_us;
+    spin_unlock(&bus->pending_lock);
+
+    list_for_each_entry(req, batch, node) {
+        req->retry_at = 0;
+        if(!req->attempt)
+            req->ret = -EINPROGRESS;
+    }
+
+    i2c_lock_bus(bus->adapter, I2C_LOCK_SEGMENT);
+
+    if(bus->combined)
+        bmp280_i2c_run_combined(bus, batch);
+
+    list_for_each_entry(req, batch, node) {
+        if(req->leader)
+            continue;
+
+        if(req->ret)
+            req->ret = bmp280_i2c_req_run(bus, req, retries, retry_us);
+        bmp280_i2c_req_store(req);
+    }
+
+    i2c_unlock_bus(bus->adapter, I2C_LOCK_SEGMENT);
+}
+
+/* Earlier of two retry times, 0 meaning none */
+static ktime_t bmp280_i2c_earlier(ktime_t a, ktime_t b)
+{
+    return !a || (b && ktime_before(b, a)) ? b : a;
+}
+
+/*
+ * Per-adapter worker, drains bus->pending one batch at a time. Requests backing off
+ * before a retry stay pending until their retry_at, the worker comes back for them then.
+ */
+static void bmp280_i2c_bus_work(struct work_struct *work)
+{
+    struct bmp280_i2c_bus *bus = container_of(to_delayed_work(work), struct bmp280_i2c_bus, work);
+    struct bmp280_i2c_req *req, *tmp;
+    ktime_t now = ktime_get(), next = 0;
+    LIST_HEAD(batch);
+    LIST_HEAD(retry);
+
+    spin_lock(&bus->pending_lock);
+    list_for_each_entry_safe(req, tmp, &bus->pending, node) {
+        if(req->retry_at && ktime_after(req->retry_at, now))
+            next = bmp280_i2c_earlier(next, req->retry_at);
+        else
+            list_move_tail(&req->node, &batch);
+    }
+    spin_unlock(&bus->pending_lock);
+
+    if(list_empty(&batch))
+        goto out;
+
+    list_sort(NULL, &batch, bmp280_i2c_req_cmp);
+    bmp280_i2c_merge_reads(&batch);
+
+    u64 wait_ns = bmp280_i2c_budget_charge(bus, &batch);
+    if(wait_ns) {
+        bmp280_i2c_budget_defer(bus, &batch, wait_ns);
+        return;
+    }
+
+    bmp280_i2c_run_batch(bus, &batch);
+
+    // Hand results to merged reads before any submitter can return and free its leader
+    list_for_each_entry(req, &batch, node) {
+        if(!req->leader)
+            continue;
+        req->retry_at = req->leader->retry_at; // Waits for the leader's retry
+        req->ret = req->leader->ret;
+        if(!req->ret)
+            memcpy(req->buf, req->leader->buf, req->len);
+    }
+
+    list_for_each_entry_safe(req, tmp, &batch, node) {
+        if(req->retry_at) {
+            next = bmp280_i2c_earlier(next, req->retry_at);
+            list_move_tail(&req->node, &retry);
+            continue;
+        }
+        list_del(&req->node);
+        complete(&req->done);
+    }
+
+    spin_lock(&bus->pending_lock);
+    list_splice(&retry, &bus->pending);
+    spin_unlock(&bus->pending_lock);
+
+out:
+    // No-op if new requests already queued the worker, it recomputes this when it runs
+    if(next)
+        queue_delayed_work(bmp280_i2c_wq, &bus->work,
+                           usecs_to_jiffies(max_t(s64, ktime_us_delta(next, ktime_get()), 0)) + 1);
+}
+
+/*
+ * Purpose:
+ *   Queues requests on the adapter's scheduler and waits for them.
+ *
+ * Parameters:
+ *   @bus:  The adapter the target sensors sit on.
+ *   @reqs: Requests to queue, i2c/write/reg/buf/len filled in by the caller.
+ *   @n:    Number of requests.
+ *
+ * Return:
+ *   0 if all requests succeeded, otherwise the error of the first one that failed.
+ *
+ * Details:
+ *   All requests are queued at once, so they always end up in the same batch. That is
+ *   what lets group reads and writes go out as one combined transfer.
+ *
+ *   The real-time acquisition worker of the target sensor does not queue: handing its
+ *   accesses to the normal priority bmp280_i2c_wq would let any ordinary load delay it.
+ *   Other real-time tasks, say a userspace control loop reading sysfs, still go through
+ *   the scheduler and its budget like everyone else.
+ *   It runs its requests as a batch of their own in its own context instead, bypassing
+ *   merging and the budget. It still has to take the adapter lock, so it can wait for a
+ *   batch of the worker or another driver that is already on the bus; the i2c core's
+ *   rt_mutex boosts that holder in the meantime.
+ */
+static int bmp280_i2c_submit(struct bmp280_i2c_bus *bus, struct bmp280_i2c_req *reqs, size_t n)
+{
+    int ret = 0;
+
+    struct bmp280_data *data = READ_ONCE(reqs[0].i2c->data);
+
+    if(data && bmp280_acq_in_realtime(data)) {
+        struct bmp280_i2c_req *req, *tmp;
+        LIST_HEAD(batch);
+
+        for(size_t i = 0; i < n; i++)
+            list_add_tail(&reqs[i].node, &batch);
+
+        for(;;) {
+            ktime_t last = 0;
+
+            bmp280_i2c_run_batch(bus, &batch);
+
+            list_for_each_entry_safe(req, tmp, &batch, node) {
+                if(!req->retry_at)
+                    list_del(&req->node);
+                else if(ktime_after(req->retry_at, last))
+                    last = req->retry_at;
+            }
+            if(list_empty(&batch))
+                break;
+
+            // Back off with the adapter released, like the worker does
+            s64 wait_us = ktime_us_delta(last, ktime_get());
+            if(wait_us > 0)
+                usleep_range(wait_us, wait_us + wait_us / 4);
+        }
+
+        for(size_t i = 0; i < n; i++) {
+            if(!ret)
+                ret = reqs[i].ret;
+        }
+        return ret;
+    }
+
+    for(size_t i = 0; i < n; i++)
+        init_completion(&reqs[i].done);
+
+    spin_lock(&bus->pending_lock);
+    for(size_t i = 0; i < n; i++)
+        list_add_tail(&reqs[i].node, &bus->pending);
+    spin_unlock(&bus->pending_lock);
+
+    queue_delayed_work(bmp280_i2c_wq, &bus->work, 0); // No-op while held back by the budget
+
+    for(size_t i = 0; i < n; i++) {
+        wait_for_completion(&reqs[i].done);
+        if(!ret)
+            ret = reqs[i].ret;
+    }
+
+    return ret;
+}
+
+/* regmap bus glue, every register access is queued on the adapter's scheduler */
+static int bmp280_i2c_regmap_read(void *context, const void *reg_buf, size_t reg_size, void *val_buf, size_t val_size)
+{
+    struct bmp280_i2c *i2c = context;
+    struct bmp280_i2c_req req = {
+        .i2c = i2c,
+        .reg = *(const u8 *)reg_buf,
+        .buf = val_buf,
+        .len = val_size,
+    };
+
+    return bmp280_i2c_submit(i2c->bus, &req, 1);
+}
+
+static int bmp280_i2c_regmap_write(void *context, const void *buf, size_t count)
+{
+    struct bmp280_i2c *i2c = context;
+    struct bmp280_i2c_req req = {
+        .i2c = i2c,
+        .write = true,
+        .buf = (u8 *)buf,
+        .len = count,
+    };
+
+    return bmp280_i2c_submit(i2c->bus, &req, 1);
+}
+
+static const struct regmap_bus bmp280_i2c_regmap_bus = {
+    .read = bmp280_i2c_regmap_read,
+    .write = bmp280_i2c_regmap_write,
+};
+
+/*
+ * Purpose:
+ *   Looks up the scheduler of an I2C adapter, creating it for the first sensor on it.
+ *
+ * Parameters:
+ *   @adapter: The I2C adapter the sensor sits on.
+ *
+ * Return:
+ *   The adapter's bmp280_i2c_bus with a reference held, or NULL if out of memory.
+ *
+ * Details:
+ *   Taken at the very start of probe, since every register access, including the ones
+ *   made while probing, goes through the scheduler. Released with bmp280_i2c_bus_put().
+ */
+static struct bmp280_i2c_bus *bmp280_i2c_bus_get(struct i2c_adapter *adapter)
+{
+    struct bmp280_i2c_bus *bus;
+
+    mutex_lock(&bmp280_i2c_buses_lock);
+
+    list_for_each_entry(bus, &bmp280_i2c_buses, node) {
+        if(bus->adapter == adapter)
+            goto found;
+    }
+
+    bus = kzalloc(sizeof(*bus), GFP_KERNEL);
+    if(!bus)
+        goto out;
+    bus->adapter = adapter;
+    bus->combined = i2c_check_functionality(adapter, I2C_FUNC_I2C);
+    INIT_LIST_HEAD(&bus->members);
+    mutex_init(&bus->lock);
+    INIT_LIST_HEAD(&bus->pending);
+    spin_lock_init(&bus->pending_lock);
+    INIT_DELAYED_WORK(&bus->work, bmp280_i2c_bus_work);
+    bus->khz = BMP280_I2C_DEFAULT_KHZ;
+    bus->retries = BMP280_I2C_DEFAULT_RETRIES;
+    bus->retry_us = BMP280_I2C_DEFAULT_RETRY_US;
+    list_add_tail(&bus->node, &bmp280_i2c_buses);
+
+found:
+    bus->users++;
+out:
+    mutex_unlock(&bmp280_i2c_buses_lock);
+    return bus;
+}
+
+static void bmp280_i2c_bus_put(struct bmp280_i2c_bus *bus)
+{
+    mutex_lock(&bmp280_i2c_buses_lock);
+
+    if(!--bus->users) {
+        list_del(&bus->node);
+        cancel_delayed_work_sync(&bus->work); // Nothing is pending, every submitter waits for its requests
+        kfree(bus);
+    }
+
+    mutex_unlock(&bmp280_i2c_buses_lock);
+}
+
+/*
+ * Adds a fully probed sensor to the members of its adapter, kept sorted by address so
+ * group transfers always address the sensors in the same order.
+ */
+static void bmp280_i2c_bus_add(struct bmp280_i2c *i2c)
+{
+    struct bmp280_i2c_bus *bus = i2c->bus;
+    struct bmp280_i2c *pos;
+
+    mutex_lock(&bus->lock);
+    list_for_each_entry(pos, &bus->members, node) {
+        if(pos->client->addr > i2c->client->addr)
+            break;
+    }
+    list_add_tail(&i2c->node, &pos->node); // Inserts in front of pos, or at the tail
+    bus->count++;
+    mutex_unlock(&bus->lock);
+}
+
+static void bmp280_i2c_bus_del(struct bmp280_i2c *i2c)
+{
+    struct bmp280_i2c_bus *bus = i2c->bus;
+
+    mutex_lock(&bus->lock);
+    list_del(&i2c->node);
+    bus->count--;
+    mutex_unlock(&bus->lock);
+}
+
+/*
+ * Purpose:
+ *   Reads the data block of every bmp280 on an adapter back to back.
+ *
+ * Parameters:
+ *   @bus:   The adapter group, bus->lock must be held by the caller.
+ *   @raw:   Output, one 0xF7-0xFC register image per member in address order.
+ *   @stamp: Output, time at which the transfer completed.
+ *
+ * Return:
+ *   0 on success, negative error code if any of the reads failed.
+ *
+ * Details:
+ *   One read per sensor, sized from its oversampling setting like bmp280_read_raw(), is
+ *   queued on the scheduler in one go. On adapters with plain I2C support the batch goes
+ *   out as one message array (register pointer write + data read per sensor, joined by
+ *   repeated starts) under a single bus lock, so no other bus traffic can be arbitrated
+ *   in between and the samples are as closely aligned in time as the bus allows.
+ */
+static int bmp280_i2c_bus_read(struct bmp280_i2c_bus *bus, u8 (*raw)[BMP280_DATA_LEN], ktime_t *stamp)
+{
+    struct bmp280_i2c *member;
+    size_t i = 0;
+    int ret = 0;
+
+    struct bmp280_i2c_req *reqs = kcalloc(bus->count, sizeof(*reqs), GFP_KERNEL);
+    if(!reqs)
+        return -ENOMEM;
+
+    list_for_each_entry(member, &bus->members, node) {
+        size_t len;
+        ret = bmp280_data_window(member->data, true, &reqs[i].reg, &len);
+        if(ret < 0)
+            goto out;
+
+        memset(raw[i], 0, BMP280_DATA_LEN);
+        reqs[i].i2c = member;
+        reqs[i].buf = raw[i] + (reqs[i].reg - BMP280_DATA_REG);
+        reqs[i].len = len;
+        i++;
+    }
+
+    ret = bmp280_i2c_submit(bus, reqs, bus->count);
+    *stamp = ktime_get();
+
+out:
+    kfree(reqs);
+    return ret;
+}
+
+/*
+ * Purpose:
+ *   Writes one ctrl_meas value to every bmp280 on an adapter.
+ *
+ * Parameters:
+ *   @bus:    The adapter group, bus->lock must be held by the caller.
+ *   @values: ctrl_meas value per member in address order.
+ *
+ * Return:
+ *   0 on success, negative error code if any of the writes failed.
+ *
+ * Details:
+ *   Like bmp280_i2c_bus_read(), all writes are queued in one go and go out as one
+ *   message array when the adapter supports plain I2C, so every sensor receives its
+ *   value within a few bit times of the others. The writes bypass regmap, so the
+ *   caller is responsible for keeping its cached ctrl_meas in line with the sensors.
+ */
+static int bmp280_i2c_bus_write_ctrl(struct bmp280_i2c_bus *bus, const u8 *values)
+{
+    struct bmp280_i2c *member;
+    size_t i = 0;
+
+    struct bmp280_i2c_req *reqs = kcalloc(bus->count, sizeof(*reqs), GFP_KERNEL);
+    u8 *pairs = kcalloc(bus->count, 2, GFP_KERNEL);
+    if(!reqs || !pairs) {
+        kfree(reqs);
+        kfree(pairs);
+        return -ENOMEM;
+    }
+
+    list_for_each_entry(member, &bus->members, node) {
+        pairs[2 * i] = BMP280_REG_CTRL_MEAS;
+        pairs[2 * i + 1] = values[i];
+        reqs[i].i2c = member;
+        reqs[i].write = true;
+        reqs[i].buf = &pairs[2 * i];
+        reqs[i].len = 2;
+        i++;
+    }
+
+    int ret = bmp280_i2c_submit(bus, reqs, bus->count);
+
+    kfree(reqs);
+    kfree(pairs);
+    return ret;
+}
+
+/*
+ * Purpose:
+ *   Starts a forced conversion on every bmp280 on an adapter at the same moment and
+ *   collects all results.
+ *
+ * Parameters:
+ *   @bus:   The adapter group, bus->lock must be held by the caller.
+ *   @raw:   Output, one 0xF7-0xFC register image per member in address order.
+ *   @stamp: Output, time at which the results were read.
+ *
+ * Return:
+ *   0 on success, -EBUSY while any member runs background acquisition, other negative
+ *   error codes if sensor communication fails.
+ *
+ * Details:
+ *   The forced-mode ctrl_meas value of every sensor (its own oversampling, mode = 01)
+ *   goes out in one message array, so the conversions start within a few bit times of
+ *   each other. The bus is released while the sensors convert, then all results are
+ *   read in one burst once the longest conversion time (measured or datasheet, see
+ *   bmp280_measure_time_us()) has passed. Sensors that were in normal mode are switched
+ *   back to it afterwards, all others are left asleep. The core lock of every member is
+ *   held for the whole cycle so no reconfiguration can sneak in between saving and
+ *   restoring ctrl_meas. Acquisition owns its sensor's mode, a forced conversion in
+ *   the middle of it would cost high-rate acquisition its armed conversion and normal
+ *   mode acquisition a period, so the acquisition lock of every member is held as well
+ *   and the trigger refused while any of them acquires.
+ */
+static int bmp280_i2c_bus_trigger(struct bmp280_i2c_bus *bus, u8 (*raw)[BMP280_DATA_LEN], ktime_t *stamp)
+{
+    struct bmp280_i2c *member;
+    unsigned int wait_us = 0;
+    size_t i = 0;
+    int ret = 0;
+
+    u8 *saved = kcalloc(bus->count, 3, GFP_KERNEL);
+    if(!saved)
+        return -ENOMEM;
+    u8 *forced = saved + bus->count;
+    u8 *restore = forced + bus->count;
+
+    /*
+     * Same order as bmp280_acq_set_mode(), whose stop waits for steps taking the core lock.
+     * All members' locks share a lockdep class each, bus->lock is what serializes taking
+     * several of them.
+     */
+    list_for_each_entry(member, &bus->members, node)
+        mutex_lock_nest_lock(&member->data->acq_lock, &bus->lock);
+
+    list_for_each_entry(member, &bus->members, node) {
+        if(member->data->acq_mode != BMP280_ACQ_OFF) {
+            ret = -EBUSY;
+            goto out_acq;
+        }
+    }
+
+    list_for_each_entry(member, &bus->members, node)
+        mutex_lock_nest_lock(&member->data->lock, &bus->lock);
+
+    list_for_each_entry(member, &bus->members, node) {
+        unsigned int ctrl_meas;
+        ret = regmap_read(member->data->regmap, BMP280_REG_CTRL_MEAS, &ctrl_meas); // From the regmap cache
+        if(ret < 0)
+            goto out;
+
+        saved[i] = ctrl_meas;
+        forced[i] = (ctrl_meas & ~BMP280_MODE_MASK) | BMP280_MODE_FORCED;
+        if((ctrl_meas & BMP280_MODE_MASK) == BMP280_MODE_NORMAL)
+            restore[i] = ctrl_meas;
+        else
+            restore[i] = (ctrl_meas & ~BMP280_MODE_MASK) | BMP280_MODE_SLEEP;
+        wait_us = max(wait_us, bmp280_measure_time_us(member->data, ctrl_meas));
+        i++;
+    }
+
+    ret = bmp280_i2c_bus_write_ctrl(bus, forced);
+    if(ret < 0)
+        goto out_drop;
+
+    usleep_range(wait_us, wait_us + wait_us / 8);
+
+    ret = bmp280_i2c_bus_read(bus, raw, stamp);
+
+    int restore_ret = bmp280_i2c_bus_write_ctrl(bus, restore);
+    if(ret == 0)
+        ret = restore_ret;
+
+out_drop:
+    /*
+     * The writes bypassed regmap, which leaves its cached ctrl_meas stale wherever the
+     * sensor did not end up back on its saved value, drop those entries so the next
+     * access rereads the register.
+     */
+    i = 0;
+    list_for_each_entry(member, &bus->members, node) {
+        if(ret < 0 || restore[i] != saved[i])
+            regcache_drop_region(member->data->regmap, BMP280_REG_CTRL_MEAS, BMP280_REG_CTRL_MEAS);
+        i++;
+    }
+
+out:
+    list_for_each_entry(member, &bus->members, node)
+        mutex_unlock(&member->data->lock);
+out_acq:
+    list_for_each_entry(member, &bus->members, node)
+        mutex_unlock(&member->data->acq_lock);
+
+    kfree(saved);
+    return ret;
+}
+
+/* Adapter scheduler of the bmp280 behind a sysfs device */
+static struct bmp280_i2c_bus *bmp280_i2c_dev_bus(struct device *dev)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+
+    return ((struct bmp280_i2c *)data->bus_priv)->bus;
+}
+
+/* Formats one group sample: the timestamp followed by one line per sensor in address order */
+static ssize_t bmp280_i2c_bus_emit(struct bmp280_i2c_bus *bus, u8 (*raw)[BMP280_DATA_LEN], ktime_t stamp, char *buf)
+{
+    struct bmp280_i2c *member;
+    size_t i = 0;
+
+    ssize_t len = sysfs_emit(buf, "Timestamp: %lldns\n", ktime_to_ns(stamp));
+
+    list_for_each_entry(member, &bus->members, node) {
+        struct bmp280_sample sample;
+
+        memcpy(sample.raw, raw[i++], BMP280_DATA_LEN);
+        if(bmp280_compensate_sample(member->data, &sample) < 0)
+            len += sysfs_emit_at(buf, len, "0x%02x: unavailable\n", member->client->addr);
+        else if(!sample.press)
+            len += sysfs_emit_at(buf, len, "0x%02x: Temperature: %d°C Pressure: unavailable\n",
+                                 member->client->addr, sample.temp/100);
+        else
+            len += sysfs_emit_at(buf, len, "0x%02x: Temperature: %d°C Pressure: %uPa\n",
+                                 member->client->addr, sample.temp/100, sample.press/256);
+    }
+
+    return len;
+}
+
+/*
+ * Purpose:
+ *   Shared sysfs show function of the group attributes.
+ *
+ * Parameters:
+ *   @dev:     Any bmp280 on the adapter.
+ *   @buf:     Output buffer where the result string is written.
+ *   @trigger: True to start a synchronized forced conversion first, false to read the
+ *             latest results.
+ *
+ * Return:
+ *   Number of bytes written to the buffer, or a negative error code.
+ */
+static ssize_t bmp280_i2c_bus_show(struct device *dev, char *buf, bool trigger)
+{
+    struct bmp280_i2c_bus *bus = bmp280_i2c_dev_bus(dev);
+    ktime_t stamp;
+
+    mutex_lock(&bus->lock);
+
+    u8 (*raw)[BMP280_DATA_LEN] = kcalloc(bus->count, sizeof(*raw), GFP_KERNEL);
+    ssize_t ret = -ENOMEM;
+    if(raw)
+        ret = trigger ? bmp280_i2c_bus_trigger(bus, raw, &stamp) : bmp280_i2c_bus_read(bus, raw, &stamp);
+
+    if(ret < 0)
+        dev_err(dev, "Failed to read the sensors on %s\n", dev_name(&bus->adapter->dev));
+    else
+        ret = bmp280_i2c_bus_emit(bus, raw, stamp, buf);
+
+    mutex_unlock(&bus->lock);
+    kfree(raw);
+    return ret;
+}
+
+/*
+ * Sysfs show function sampling every bmp280 on the adapter at once, e.g.
+ * 'cat /sys/bus/i2c/devices/1-0076/Bmp280-Bus-Calculations' prints the transfer timestamp
+ * followed by one line per sensor in address order.
+ */
+static ssize_t bus_calculations_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_i2c_bus_show(dev, buf, false);
+}
+static struct device_attribute dev_attr_bus_calculations = __ATTR(Bmp280-Bus-Calculations, 0444, bus_calculations_show, NULL);
+
+/*
+ * Sysfs show function starting a synchronized forced conversion on every bmp280 on the
+ * adapter, e.g. 'cat /sys/bus/i2c/devices/1-0076/Bmp280-Bus-Trigger'. Same output format
+ * as Bmp280-Bus-Calculations.
+ */
+static ssize_t bus_trigger_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_i2c_bus_show(dev, buf, true);
+}
+static struct device_attribute dev_attr_bus_trigger = __ATTR(Bmp280-Bus-Trigger, 0444, bus_trigger_show, NULL);
+
+/* Shared show/store helpers of the adapter settings, which every bmp280 on the adapter exposes */
+static ssize_t bmp280_i2c_setting_show(struct device *dev, char *buf, const unsigned int *field)
+{
+    struct bmp280_i2c_bus *bus = bmp280_i2c_dev_bus(dev);
+
+    spin_lock(&bus->pending_lock);
+    unsigned int value = *field;
+    spin_unlock(&bus->pending_lock);
+
+    return sysfs_emit(buf, "%u\n", value);
+}
+
+static ssize_t bmp280_i2c_setting_store(struct device *dev, const char *buf, size_t count, unsigned int *field,
+                                       unsigned int min, unsigned int max)
+{
+    struct bmp280_i2c_bus *bus = bmp280_i2c_dev_bus(dev);
+    unsigned int value;
+
+    int ret = kstrtouint(buf, 0, &value);
+    if(ret < 0)
+        return ret;
+    if(value < min || value > max)
+        return -EINVAL;
+
+    spin_lock(&bus->pending_lock);
+    *field = value;
+    bmp280_i2c_budget_reset(bus);
+    spin_unlock(&bus->pending_lock);
+
+    // Requests held back under the old settings may be allowed through now
+    mod_delayed_work(bmp280_i2c_wq, &bus->work, 0);
+    return count;
+}
+
+/*
+ * Sysfs attributes limiting the bus traffic of all bmp280s on the adapter, e.g.
+ * 'echo 50 > /sys/bus/i2c/devices/1-0076/Bmp280-Bus-Budget-Tps' allows 50 register
+ * accesses per second and 'echo 5 > .../Bmp280-Bus-Budget-Share' 5% of the bus time,
+ * estimated from the bytes moved at Bmp280-Bus-Khz. 0 disables a limit.
+ */
+static ssize_t bus_budget_tps_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_i2c_setting_show(dev, buf, &bmp280_i2c_dev_bus(dev)->max_tps);
+}
+
+static ssize_t bus_budget_tps_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_i2c_setting_store(dev, buf, count, &bmp280_i2c_dev_bus(dev)->max_tps, 0, 1000000);
+}
+static struct device_attribute dev_attr_bus_budget_tps = __ATTR(Bmp280-Bus-Budget-Tps, 0644, bus_budget_tps_show, bus_budget_tps_store);
+
+static ssize_t bus_budget_share_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_i2c_setting_show(dev, buf, &bmp280_i2c_dev_bus(dev)->max_share);
+}
+
+static ssize_t bus_budget_share_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_i2c_setting_store(dev, buf, count, &bmp280_i2c_dev_bus(dev)->max_share, 0, 100);
+}
+static struct device_attribute dev_attr_bus_budget_share = __ATTR(Bmp280-Bus-Budget-Share, 0644, bus_budget_share_show, bus_budget_share_store);
+
+static ssize_t bus_khz_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_i2c_setting_show(dev, buf, &bmp280_i2c_dev_bus(dev)->khz);
+}
+
+static ssize_t bus_khz_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_i2c_setting_store(dev, buf, count, &bmp280_i2c_dev_bus(dev)->khz, 1, 3400); // Up to high-speed mode
+}
+static struct device_attribute dev_attr_bus_khz = __ATTR(Bmp280-Bus-Khz, 0644, bus_khz_show, bus_khz_store);
+
+/*
+ * Sysfs attribute selecting what happens to requests while the adapter is over budget:
+ * "delay" holds them back until the budget has refilled, "cache" answers data reads
+ * from the last sample read from the sensor and only delays the rest.
+ */
+static ssize_t bus_budget_policy_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%s\n", bmp280_i2c_dev_bus(dev)->serve_cached ? "cache" : "delay");
+}
+
+static ssize_t bus_budget_policy_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct bmp280_i2c_bus *bus = bmp280_i2c_dev_bus(dev);
+    bool serve_cached;
+
+    if(sysfs_streq(buf, "cache"))
+        serve_cached = true;
+    else if(sysfs_streq(buf, "delay"))
+        serve_cached = false;
+    else
+        return -EINVAL;
+
+    spin_lock(&bus->pending_lock);
+    bus->serve_cached = serve_cached;
+    spin_unlock(&bus->pending_lock);
+
+    return count;
+}
+static struct device_attribute dev_attr_bus_budget_policy = __ATTR(Bmp280-Bus-Budget-Policy, 0644, bus_budget_policy_show, bus_budget_policy_store);
+
+/* Sysfs show function reporting how often the adapter's budget held traffic back */
+static ssize_t bus_budget_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_i2c_bus *bus = bmp280_i2c_dev_bus(dev);
+
+    spin_lock(&bus->pending_lock);
+    unsigned long hits = bus->budget_hits, delayed = bus->delayed, cached = bus->cached;
+    spin_unlock(&bus->pending_lock);
+
+    return sysfs_emit(buf, "Budget hits: %lu\nDelayed: %lu\nCached: %lu\n", hits, delayed, cached);
+}
+static struct device_attribute dev_attr_bus_budget_stats = __ATTR(Bmp280-Bus-Budget-Stats, 0444, bus_budget_stats_show, NULL);
+
+/*
+ * Sysfs attributes bounding the retries of failed accesses on the adapter, e.g.
+ * 'echo 5 > /sys/bus/i2c/devices/1-0076/Bmp280-Bus-Retries' allows five retries, the
+ * last one after a bus recovery, and Bmp280-Bus-Retry-Budget-us caps the time a request
+ * may spend retrying. The adapter is released while a request backs off.
+ */
+static ssize_t bus_retries_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_i2c_setting_show(dev, buf, &bmp280_i2c_dev_bus(dev)->retries);
+}
+
+static ssize_t bus_retries_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_i2c_setting_store(dev, buf, count, &bmp280_i2c_dev_bus(dev)->retries, 0, 16);
+}
+static struct device_attribute dev_attr_bus_retries = __ATTR(Bmp280-Bus-Retries, 0644, bus_retries_show, bus_retries_store);
+
+static ssize_t bus_retry_budget_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return bmp280_i2c_setting_show(dev, buf, &bmp280_i2c_dev_bus(dev)->retry_us);
+}
+
+static ssize_t bus_retry_budget_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    return bmp280_i2c_setting_store(dev, buf, count, &bmp280_i2c_dev_bus(dev)->retry_us, 0, 1000000);
+}
+static struct device_attribute dev_attr_bus_retry_budget = __ATTR(Bmp280-Bus-Retry-Budget-us, 0644, bus_retry_budget_show, bus_retry_budget_store);
+
+/*
+ * Sysfs show function reporting the I2C errors of this sensor, e.g.
+ * 'cat /sys/bus/i2c/devices/1-0076/Bmp280-Errors'. Errors are accesses that still failed
+ * after retrying, the counters are updated by the adapter's worker only.
+ */
+static ssize_t errors_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct bmp280_data *data = dev_get_drvdata(dev);
+    struct bmp280_i2c *i2c = data->bus_priv;
+
+    return sysfs_emit(buf, "Errors: %lu\nRetries: %lu\nRecoveries: %lu\n",
+                      READ_ONCE(i2c->errors), READ_ONCE(i2c->retried), READ_ONCE(i2c->recoveries));
+}
+static struct device_attribute dev_attr_errors = __ATTR(Bmp280-Errors, 0444, errors_show, NULL);
+
+static struct attribute *bmp280_i2c_attrs[] = {
+    &dev_attr_bus_calculations.attr,
+    &dev_attr_bus_trigger.attr,
+    &dev_attr_bus_budget_tps.attr,
+    &dev_attr_bus_budget_share.attr,
+    &dev_attr_bus_khz.attr,
+    &dev_attr_bus_budget_policy.attr,
+    &dev_attr_bus_budget_stats.attr,
+    &dev_attr_bus_retries.attr,
+    &dev_attr_bus_retry_budget.attr,
+    &dev_attr_errors.attr,
+    NULL,
+};
+
+static const struct attribute_group bmp280_i2c_attr_group = {
+    .attrs = bmp280_i2c_attrs,
+};
+
+/*
+ * Purpose:
+ *   Probe function of the I2C front end, called by the I2C subsystem when the
+ *   driver is matched to a device.
+ *
+ * Parameters:
+ *   @client: Pointer to the I2C client structure representing the BMP280 device.
+ *
+ * Return:
+ *   0 on success, negative error code on failure.
+ *
+ * Details:
+ *   Picks the transfer strategy, attaches to the I/O scheduler of the adapter, puts a
+ *   regmap on top of it and hands over to bmp280_common_probe() for everything that does
+ *   not depend on the bus. The sensor then joins the group of bmp280s on its adapter for
+ *   group transfers.
+ */
+static int bmp280_i2c_probe(struct i2c_client *client)
+{
+    printk(KERN_INFO "BMP280: Probed at address 0x%02x\n", client->addr);
+
+    struct bmp280_i2c *i2c = devm_kzalloc(&client->dev, sizeof(*i2c), GFP_KERNEL);
+    if(!i2c)
+        return -ENOMEM;
+    i2c->client = client;
+
+    i2c->xfer = bmp280_select_xfer(client->adapter);
+    if(!i2c->xfer) {
+        dev_err(&client->dev, "I2C adapter supports neither I2C nor SMBus register access\n");
+        return -EOPNOTSUPP;
+    }
+    dev_info(&client->dev, "Using %s transfers\n", i2c->xfer->name);
+
+    i2c->bus = bmp280_i2c_bus_get(client->adapter);
+    if(!i2c->bus)
+        return -ENOMEM;
+
+    int ret;
+    struct regmap *regmap = devm_regmap_init(&client->dev, &bmp280_i2c_regmap_bus, i2c, &bmp280_regmap_config);
+    if(IS_ERR(regmap)) {
+        dev_err(&client->dev, "Failed to initialize the register map\n");
+        ret = PTR_ERR(regmap);
+        goto err_put;
+    }
+
+    ret = bmp280_common_probe(&client->dev, regmap, i2c->xfer->name, false);
+    if(ret < 0)
+        goto err_put;
+
+    WRITE_ONCE(i2c->data, dev_get_drvdata(&client->dev));
+    i2c->data->bus_priv = i2c;
+
+    bmp280_i2c_bus_add(i2c);
+
+    ret = sysfs_create_group(&client->dev.kobj, &bmp280_i2c_attr_group);
+    if(ret < 0) {
+        dev_err(&client->dev, "Failed to load the I2C sysfs files");
+        goto err_del;
+    }
+
+    return 0;
+
+err_del:
+    bmp280_i2c_bus_del(i2c);
+    bmp280_common_remove(&client->dev);
+err_put:
+    bmp280_i2c_bus_put(i2c->bus);
+    return ret;
+}
+
+static void bmp280_i2c_remove(struct i2c_client *client)
+{
+    struct bmp280_data *data = dev_get_drvdata(&client->dev);
+    struct bmp280_i2c *i2c = data->bus_priv;
+
+    sysfs_remove_group(&client->dev.kobj, &bmp280_i2c_attr_group);
+    bmp280_i2c_bus_del(i2c);
+    bmp280_common_remove(&client->dev);
+    bmp280_i2c_bus_put(i2c->bus);
+}
+
+static const struct i2c_device_id bmp280_i2c_id[] = { 
+    { DRIVER_NAME, 0 }, // Load this driver to an I2C device named "bmp280"
+    { }                 // Signifies end of array 
+};
+
+static const struct of_device_id bmp280_i2c_of_match[] = {
+    { .compatible = "bosch,bmp280" }, // Matches device tree node using this string
+    {},                               // Signifies end of array
+};
+
+/* Exposes table so kernel can auto-load this device driver module */
+MODULE_DEVICE_TABLE(i2c, bmp280_i2c_id);
+MODULE_DEVICE_TABLE(of, bmp280_i2c_of_match);
+
+static struct i2c_driver bmp280_i2c_driver = {
+    .driver = {
+        .name = DRIVER_NAME,
+        .of_match_table = bmp280_i2c_of_match,
+    },
+    .probe = bmp280_i2c_probe,
+    .remove = bmp280_i2c_remove,
+    .id_table = bmp280_i2c_id,
+};
+
+int bmp280_i2c_register(void)
+{
+    // High priority so queued sensor accesses are not held up behind unrelated work
+    bmp280_i2c_wq = alloc_workqueue("bmp280-i2c", WQ_HIGHPRI, 0);
+    if(!bmp280_i2c_wq)
+        return -ENOMEM;
+
+    int ret = i2c_add_driver(&bmp280_i2c_driver);
+    if(ret < 0)
+        destroy_workqueue(bmp280_i2c_wq);
+    return ret;
+}
+
+void bmp280_i2c_unregister(void)
+{
+    i2c_del_driver(&bmp280_i2c_driver);
+    destroy_workqueue(bmp280_i2c_wq);
+}
@@ -0,0 +1,127 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/spi/spi.h>   // For SPI support
+
+#include "bmp280.h"
+
+#define BMP280_SPI_MAX_HZ     10000000 // Fastest SCK the datasheet allows
+#define BMP280_SPI_WRITE_MASK 0x7F     // RW bit (bit 7) of the control byte is 0 for writes
+#define BMP280_SPI_MAX_PAIRS  8        // Longest write sequence the core ever sends is 3 pairs
+
+/*
+ * SPI reads: the control byte is the register address with RW = 1. All BMP280 registers
+ * are at 0x80 and above, so the address already has bit 7 set and goes out unchanged.
+ * The sensor auto-increments during the read just like over I2C.
+ */
+static int bmp280_spi_regmap_read(void *context, const void *reg_buf, size_t reg_size, void *val_buf, size_t val_size)
+{
+    struct spi_device *spi = context;
+
+    return spi_write_then_read(spi, reg_buf, reg_size, val_buf, val_size);
+}
+
+/*
+ * SPI writes: register/value pairs like over I2C, but each register byte must have its
+ * RW bit cleared. spi_write_then_read() copies into a DMA-safe bounce buffer, so the
+ * translated pairs can live on the stack.
+ */
+static int bmp280_spi_regmap_write(void *context, const void *data, size_t count)
+{
+    struct spi_device *spi = context;
+    u8 buf[2 * BMP280_SPI_MAX_PAIRS];
+
+    if(count > sizeof(buf) || count % 2)
+        return -EINVAL;
+
+    memcpy(buf, data, count);
+    for(size_t i = 0; i < count; i += 2)
+        buf[i] &= BMP280_SPI_WRITE_MASK;
+
+    return spi_write_then_read(spi, buf, count, NULL, 0);
+}
+
+static const struct regmap_bus bmp280_spi_regmap_bus = {
+    .read = bmp280_spi_regmap_read,
+    .write = bmp280_spi_regmap_write,
+};
+
+/*
+ * Purpose:
+ *   Probe function of the SPI front end, called by the SPI subsystem when the
+ *   driver is matched to a device.
+ *
+ * Parameters:
+ *   @spi: Pointer to the SPI device representing the BMP280.
+ *
+ * Return:
+ *   0 on success, negative error code on failure.
+ *
+ * Details:
+ *   The BMP280 supports SPI modes 0 and 3 at up to 10 MHz, the mode is taken from the
+ *   device tree (spi-cpol/spi-cpha) and the clock is capped at 10 MHz. A 'spi-3wire'
+ *   property puts the controller in half-duplex mode, the core then also sets spi3w_en
+ *   on the sensor.
+ */
+static int bmp280_spi_probe(struct spi_device *spi)
+{
+    printk(KERN_INFO "BMP280: Probed on SPI device %s\n", dev_name(&spi->dev));
+
+    spi->bits_per_word = 8;
+    if(!spi->max_speed_hz || spi->max_speed_hz > BMP280_SPI_MAX_HZ)
+        spi->max_speed_hz = BMP280_SPI_MAX_HZ;
+
+    int ret = spi_setup(spi);
+    if(ret < 0) {
+        dev_err(&spi->dev, "Failed to set up the SPI device\n");
+        return ret;
+    }
+
+    struct regmap *regmap = devm_regmap_init(&spi->dev, &bmp280_spi_regmap_bus, spi, &bmp280_regmap_config);
+    if(IS_ERR(regmap)) {
+        dev_err(&spi->dev, "Failed to initialize the register map\n");
+        return PTR_ERR(regmap);
+    }
+
+    bool spi3w = spi->mode & SPI_3WIRE;
+
+    return bmp280_common_probe(&spi->dev, regmap, spi3w ? "spi-3wire" : "spi-4wire", spi3w);
+}
+
+static void bmp280_spi_remove(struct spi_device *spi)
+{
+    bmp280_common_remove(&spi->dev);
+}
+
+static const struct spi_device_id bmp280_spi_id[] = {
+    { DRIVER_NAME, 0 }, // Load this driver to an SPI device named "bmp280"
+    { }                 // Signifies end of array
+};
+
+static const struct of_device_id bmp280_spi_of_match[] = {
+    { .compatible = "bosch,bmp280" }, // Matches device tree node using this string
+    {},                               // Signifies end of array
+};
+
+/* Exposes table so kernel can auto-load this device driver module */
+MODULE_DEVICE_TABLE(spi, bmp280_spi_id);
+MODULE_DEVICE_TABLE(of, bmp280_spi_of_match);
+
+static struct spi_driver bmp280_spi_driver = {
+    .driver = {
+        .name = DRIVER_NAME,
+        .of_match_table = bmp280_spi_of_match,
+    },
+    .probe = bmp280_spi_probe,
+    .remove = bmp280_spi_remove,
+    .id_table = bmp280_spi_id,
+};
+
+int bmp280_spi_register(void)
+{
+    return spi_register_driver(&bmp280_spi_driver);
+}
+
+void bmp280_spi_unregister(void)
+{
+    spi_unregister_driver(&bmp280_spi_driver);
+}
@@ -0,0 +1,38 @@
+#ifndef BMP280_UAPI_H
+#define BMP280_UAPI_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Userspace interface of the /dev/bmp280-<device> character devices. Every read()
+ * returns whole struct bmp280_reading records, oldest first.
+ */
+
+struct bmp280_reading {
+    __s64 timestamp_ns; // CLOCK_MONOTONIC time at which the data registers were read
+    __s32 temperature;  // Hundredths of a degree Celsius
+    __u32 pressure;     // Pa as unsigned Q24.8 fixed point, divide by 256 for Pa, 0 if skipped
+};
+
+/*
+ * BMP280_IOC_READ_DEADLINE: returns one sample no older than max_staleness_us, within
+ * deadline_us. The latest sample is returned if it is recent enough (the oversampling
+ * fields are then 0), otherwise a forced conversion runs at the highest oversampling
+ * preset whose conversion time fits the deadline. Fails with ETIME if not even x1/x1
+ * fits, and with EBUSY if a fresh conversion is needed while background acquisition
+ * runs. The layout is identical for 32-bit and 64-bit userspace.
+ */
+struct bmp280_deadline_read {
+    struct bmp280_reading reading;  // Out: the sample
+    __u32 max_staleness_us;         // In: oldest acceptable sample age, 0 always converts
+    __u32 deadline_us;              // In: time budget for a fresh conversion
+    __u8 temperature_oversampling;  // Out: osrs_t ratio of a fresh conversion (1-16)
+    __u8 pressure_oversampling;     // Out: osrs_p ratio of a fresh conversion (1-16)
+    __u8 reserved[6];
+};
+
+#define BMP280_IOC_MAGIC         0xB2
+#define BMP280_IOC_READ_DEADLINE _IOWR(BMP280_IOC_MAGIC, 1, struct bmp280_deadline_read)
+
+#endif /* BMP280_UAPI_H */
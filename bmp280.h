@@ -0,0 +1,256 @@
+#ifndef BMP280_H
+#define BMP280_H
+
+#include <linux/device.h>
+#include <linux/regmap.h>    // For cached register access
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/completion.h>
+#include <linux/seqlock.h>
+#include <linux/cache.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/kfifo.h>
+#include <linux/miscdevice.h>
+#include <linux/wait.h>
+#include <linux/kref.h>
+
+#include "bmp280-uapi.h"
+
+#define DRIVER_NAME "bmp280"
+
+#define BMP280_DATA_REG 0xF7 // press_msb, first of the 0xF7-0xFC data block
+#define BMP280_DATA_LEN 6    // press_msb/lsb/xlsb followed by temp_msb/lsb/xlsb
+
+#define BMP280_CALIB_REG 0x88 // dig_T1 LSB, first of the 0x88-0x9F calibration block
+#define BMP280_CALIB_LEN 24   // 12 little-endian words: dig_T1..dig_T3, dig_P1..dig_P9
+
+#define BMP280_REG_CHIP_ID   0xD0
+#define BMP280_REG_RESET     0xE0
+#define BMP280_REG_STATUS    0xF3
+#define BMP280_REG_CTRL_MEAS 0xF4
+#define BMP280_REG_CONFIG    0xF5
+#define BMP280_REG_PRESS_LSB  0xF8
+#define BMP280_REG_PRESS_XLSB 0xF9
+#define BMP280_REG_TEMP_MSB  0xFA
+#define BMP280_REG_TEMP_LSB  0xFB
+#define BMP280_REG_TEMP_XLSB 0xFC // Last register of the map
+
+#define BMP280_STATUS_MEASURING 0x08 // measuring[0] of status, a conversion is running
+#define BMP280_STATUS_IM_UPDATE 0x01 // im_update[0] of status, NVM data is being copied
+
+#define BMP280_MODE_MASK   0x03 // mode[1 : 0] of ctrl_meas
+#define BMP280_MODE_SLEEP  0x00
+#define BMP280_MODE_FORCED 0x01 // One measurement, then back to sleep
+#define BMP280_MODE_NORMAL 0x03 // Continuous measurements separated by t_sb
+
+#define BMP280_OSRS_T_MASK  0xE0 // osrs_t[2 : 0] of ctrl_meas
+#define BMP280_OSRS_T_SHIFT 5
+#define BMP280_OSRS_P_MASK  0x1C // osrs_p[2 : 0] of ctrl_meas
+#define BMP280_OSRS_P_SHIFT 2
+#define BMP280_OSRS_X1      1    // 16-bit resolution, the xlsb register carries nothing
+#define BMP280_ADC_SKIPPED  0x80000 // Raw reading of a channel whose osrs is 0 (skipped)
+
+#define BMP280_T_SB_MASK    0xE0 // t_sb[2 : 0] of config
+#define BMP280_T_SB_SHIFT   5
+#define BMP280_FILTER_MASK  0x1C // filter[2 : 0] of config
+#define BMP280_FILTER_SHIFT 2
+#define BMP280_SPI3W_EN     0x01 // spi3w_en[0] of config, 3-wire SPI
+
+/* One compensated measurement, as published by bmp280_publish() */
+struct bmp280_sample {
+    u8 raw[BMP280_DATA_LEN]; // 0xF7-0xFC register image the values were computed from
+    s32 temp;                // Temperature in hundredths of a degree Celsius
+    u32 press;               // Pressure in Pa as unsigned Q24.8 fixed point, 0 if not measured
+    s32 t_fine;              // Fine temperature the pressure was compensated with
+    ktime_t timestamp;       // When the registers were read, 0 if there is no sample yet
+};
+
+/*
+ * The latest sample together with the seqlock publishing it. Readers never write to it,
+ * so it gets cachelines of its own and readers on many CPUs do not bounce them with the
+ * writes to the rest of bmp280_data.
+ */
+struct bmp280_published {
+    seqlock_t lock;
+    struct bmp280_sample sample;
+} ____cacheline_aligned;
+
+/* How the latest sample is kept up to date, selected through Bmp280-Acquisition */
+enum bmp280_acq_mode {
+    BMP280_ACQ_OFF,      // Every reader goes to the sensor
+    BMP280_ACQ_PERIODIC, // A worker fetches each normal-mode conversion once
+    BMP280_ACQ_HIGHRATE, // Back to back forced conversions paced by an hrtimer
+    BMP280_ACQ_ADAPTIVE, // Periodic, with t_sb following how fast pressure changes
+};
+
+/* Phase lock of periodic acquisition to the sensor's own normal-mode cadence */
+struct bmp280_phase {
+    s64 nominal_ns;          // t_measure + t_sb of the settings the estimate belongs to
+    s64 period_ns;           // Estimated true period of the sensor
+    s64 lead_ns;             // How much earlier than period_ns after a conversion the next read is aimed
+    ktime_t last_new;        // When the latest new conversion was read, 0 before the first
+    u8 last_raw[BMP280_DATA_LEN];
+
+    // Reported in Bmp280-Stats, kept across settings changes
+    unsigned long duplicates; // Reads that found the previous conversion again
+    unsigned long missed;     // Conversions that were never read
+    s64 estimate_ns;          // Copy of period_ns for readers
+};
+
+/* Adaptive acquisition, the rate controller on top of periodic acquisition */
+struct bmp280_adapt {
+    unsigned int min_period_us;   // Fastest allowed t_measure + t_sb
+    unsigned int max_period_us;   // Slowest allowed t_measure + t_sb
+    unsigned int rise_pa_s;       // |dP/dt| above which the rate goes up
+    unsigned int fall_pa_s;       // |dP/dt| below which the rate decays
+
+    // Written by acq_work only
+    unsigned int t_sb;            // Standby code in use
+    unsigned int saved_t_sb;      // Standby code to restore when adaptive acquisition stops
+    u32 ref_press;                // Pressure at the start of the current derivative window
+    ktime_t ref_time;             // Start of the window, 0 before the first sample
+    unsigned int calm;            // Consecutive windows below fall_pa_s
+    u64 slope;                    // Latest |dP/dt| in Pa/s as Q24.8, for Bmp280-Stats
+    unsigned long steps_up, steps_down;
+};
+
+/* Rate and jitter of high-rate acquisition, intervals between consecutive samples in ns */
+struct bmp280_rate_stats {
+    ktime_t start;         // First sample since high-rate acquisition was switched on
+    ktime_t last;          // Latest sample
+    u64 samples;
+    s64 interval_min, interval_max;
+    u64 jitter_sum;        // Sum of |interval - mean interval so far|
+    u64 jitter_max;
+};
+
+/* Deadband of one channel, samples are only delivered once it moves past the band */
+struct bmp280_deadband {
+    unsigned int abs;      // In the channel's unit, 0.01 °C or Pa, 0 for none
+    unsigned int rel_ppm;  // Of the last delivered value, 0 for none
+};
+
+/* Distribution of a duration, for Bmp280-Stats */
+#define BMP280_HIST_BUCKETS 16 // log2 microsecond buckets, <1 us up to >= 16 ms
+struct bmp280_latency {
+    u64 count;
+    s64 sum_ns, min_ns, max_ns;
+    unsigned long hist[BMP280_HIST_BUCKETS];
+};
+
+/*
+ * Character device of a sensor, see bmp280-cdev.c. Refcounted apart from bmp280_data,
+ * which goes away on remove, so open files keep the fifo and wait queue alive.
+ */
+struct bmp280_cdev {
+    struct kref ref;                 // Held by the sensor until remove and by every open file
+    struct miscdevice miscdev;       // /dev/bmp280-<device>, streams published samples
+    struct bmp280_data *data;        // Only valid while removed is false
+    DECLARE_KFIFO_PTR(fifo, struct bmp280_reading); // Filled under latest.lock, drained under fifo_lock
+    struct mutex fifo_lock;          // Serializes readers and ioctls, protects removed
+    wait_queue_head_t fifo_wait;     // Woken when a sample is queued or the sensor is removed
+    bool removed;                    // The sensor is gone, open files only see -ENODEV
+};
+
+#define BMP280_TTL_AUTO UINT_MAX // cache_ttl_us following the measurement period
+
+struct bmp280_data {
+    struct device *dev;              // The I2C or SPI device the sensor was probed on
+    struct regmap *regmap;           // Cached register access, every bus transfer goes through here
+    const char *transfer;            // How the transport talks to the sensor, shown in Bmp280-Transfer
+    u8 config_flags;                 // Bits that must stay set in every config write (spi3w_en)
+    void *bus_priv;                  // Front end state, owned by bmp280-i2c.c or bmp280-spi.c
+    unsigned int t_measured_us[6];   // Measured conversion time per symmetric osrs code, 0 if not measured
+    unsigned int t_scale;            // Measured/datasheet conversion time in 1/1000, 0 for the datasheet maxima
+    unsigned int period_us;          // Normal-mode t_measure + t_sb, kept current by every change of either
+    struct mutex lock;               // Serializes read-modify-write reconfiguration of ctrl_meas/config
+    unsigned int temp_interval;      // Forced conversions measure temperature every Nth time, 1 for always
+    unsigned int temp_max_age_us;    // ... or once the cached t_fine is this old, 0 for no age limit
+    unsigned int temp_cycles;        // Forced conversions since temperature was last due, under lock
+
+    struct bmp280_published latest;  // Latest measurement, from the worker or a synchronous read
+    unsigned int cache_ttl_us;       // How long readers reuse the latest sample instead of reading the sensor
+
+    spinlock_t read_lock;            // Protects the single-flight read state below and the statistics
+    bool read_busy;                  // A reader is fetching a sample from the sensor
+    int read_ret;                    // Result of the last fetch, handed to the readers that waited on it
+    struct completion read_done;     // Completed whenever a fetch ends
+    unsigned long coalesced;         // Readers that waited on another reader's fetch instead of the bus
+    s32 t_fine_cached, temp_cached;  // Latest measured temperature, reused by conversions that skip it
+    ktime_t t_fine_stamp;            // When it was compensated, 0 if never
+    unsigned long temp_reused;       // Samples compensated with the cached t_fine
+    struct mutex acq_lock;           // Serializes changes of acq_mode and on_demand
+    bool on_demand;                  // Forced mode, readers run their own conversions and the sensor sleeps
+    enum bmp280_acq_mode acq_mode;
+    struct work_struct acq_work;     // Runs the periodic and high-rate steps, see bmp280-acq.c
+    bool acq_realtime;               // Steps run on the SCHED_FIFO acq_kworker instead of acq_work
+    struct kthread_worker *acq_kworker; // Real-time worker running acq_kwork instead of acq_work
+    struct kthread_work acq_kwork;
+    struct hrtimer acq_timer;        // Paces the steps on absolute time
+    ktime_t acq_expires;             // When the timer was due, 0 for steps queued directly
+    struct bmp280_latency activation; // Timer expiry to step start, protected by read_lock
+    struct bmp280_latency read_time; // Data register reads of the steps, protected by read_lock
+    struct bmp280_phase phase;       // Written by acq_work only
+    struct bmp280_adapt adapt;
+    bool hr_armed;                   // A high-rate conversion was started and not read yet
+    bool hr_temp;                    // ... and it measures temperature
+    u8 hr_saved_mode;                // ctrl_meas mode to restore when high-rate acquisition stops
+    struct bmp280_rate_stats rate;   // Protected by read_lock
+
+    struct bmp280_cdev *cdev;        // /dev/bmp280-<device>, streams published samples
+    unsigned long overruns;          // Samples dropped because the fifo was full
+    struct bmp280_deadband db_temp, db_press;
+    s32 db_last_temp;                // Last delivered values, under latest.lock
+    u32 db_last_press;
+    bool db_valid;                   // Something was delivered since the deadband last changed
+    unsigned long suppressed;        // Samples held back by the deadband
+
+    /* Caliberation registers in BMP 280 */
+    unsigned short dig_T1, dig_P1; 
+    short dig_T2, dig_T3,
+    dig_P2, dig_P3, dig_P4, dig_P5,
+    dig_P6, dig_P7, dig_P8, dig_P9;
+};
+
+/* bmp280-core.c: transport-agnostic part of the driver */
+extern const struct regmap_config bmp280_regmap_config;
+int bmp280_common_probe(struct device *dev, struct regmap *regmap, const char *transfer, bool spi3w);
+void bmp280_common_remove(struct device *dev);
+int bmp280_data_window(struct bmp280_data *data, bool want_press, u8 *reg, size_t *len);
+int bmp280_read_raw(struct bmp280_data *data, bool want_press, u8 raw[BMP280_DATA_LEN]);
+int bmp280_read_press(struct bmp280_data *data, u8 raw[BMP280_DATA_LEN]);
+int bmp280_start_forced(struct bmp280_data *data, u8 ctrl_meas, bool *temp);
+int bmp280_read_forced(struct bmp280_data *data, u8 osrs, u8 raw[BMP280_DATA_LEN]);
+int bmp280_read_deadline(struct bmp280_data *data, unsigned int max_staleness_us, unsigned int deadline_us,
+                         struct bmp280_sample *sample, u8 *osrs);
+unsigned int bmp280_measure_time_us(struct bmp280_data *data, u8 ctrl_meas);
+unsigned int bmp280_standby_time_us(unsigned int t_sb);
+unsigned int bmp280_period_us(struct bmp280_data *data);
+int bmp280_update_field(struct bmp280_data *data, unsigned int reg, u8 mask, u8 value);
+int bmp280_compensate_sample(struct bmp280_data *data, struct bmp280_sample *sample);
+
+/* bmp280-acq.c: latest sample and background acquisition */
+extern const struct attribute_group bmp280_acq_attr_group;
+void bmp280_acq_init(struct bmp280_data *data);
+void bmp280_acq_remove(struct bmp280_data *data);
+bool bmp280_acq_in_realtime(struct bmp280_data *data);
+void bmp280_publish(struct bmp280_data *data, const struct bmp280_sample *sample);
+bool bmp280_latest(struct bmp280_data *data, struct bmp280_sample *sample);
+bool bmp280_fresh(struct bmp280_data *data, struct bmp280_sample *sample);
+
+/* bmp280-cdev.c: character device streaming the published samples */
+int bmp280_cdev_register(struct bmp280_data *data);
+void bmp280_cdev_unregister(struct bmp280_data *data);
+extern const struct attribute_group bmp280_cdev_attr_group;
+bool bmp280_cdev_push(struct bmp280_data *data, const struct bmp280_sample *sample);
+
+/* bmp280-i2c.c and bmp280-spi.c: transport front ends, registered from the core's module init */
+int bmp280_i2c_register(void);
+void bmp280_i2c_unregister(void);
+int bmp280_spi_register(void);
+void bmp280_spi_unregister(void);
+
+#endif /* BMP280_H */